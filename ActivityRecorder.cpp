@@ -0,0 +1,60 @@
+#include <cerrno>
+#include <iostream>
+#include <string.h>
+
+#include "ActivityRecorder.h"
+
+using namespace std;
+
+ActivityRecorder::ActivityRecorder(const string &path, const MetricRegistry &registry) {
+	_file = fopen(path.c_str(), "wb");
+	if (!_file) {
+		cout << "Opening recording " << path << " failed: " << strerror(errno) << endl;
+		return;
+	}
+	_metricCount = registry.metric_count();
+	RecordingHeader header;
+	memcpy(header.magic, recordingMagic, sizeof(header.magic));
+	header.version = recordingVersion;
+	header.metricCount = _metricCount;
+	fwrite(&header, sizeof(header), 1, _file);
+	for (MetricId id = 0; id < _metricCount; ++id) {
+		const MetricInfo &info = registry.info(id);
+		write_string(info.name);
+		write_string(info.unit);
+		uint8_t precision = info.precision;
+		fwrite(&precision, sizeof(precision), 1, _file);
+	}
+	_start = chrono::steady_clock::now();
+}
+
+ActivityRecorder::~ActivityRecorder() {
+	if (_file) {
+		fclose(_file);
+	}
+}
+
+bool ActivityRecorder::is_open() {
+	return _file != nullptr;
+}
+
+void ActivityRecorder::record(const MetricRegistry &registry) {
+	if (!_file) {
+		return;
+	}
+	int64_t timestamp = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - _start).count();
+	fwrite(&timestamp, sizeof(timestamp), 1, _file);
+	fwrite(registry.snapshot(), sizeof(float), _metricCount, _file);
+	// The monitor is normally stopped with Ctrl-C, keep what has been recorded so far
+	fflush(_file);
+}
+
+//
+// Private methods
+//
+
+void ActivityRecorder::write_string(const string &str) {
+	uint8_t length = static_cast<uint8_t>(min(str.size(), (size_t)255));
+	fwrite(&length, sizeof(length), 1, _file);
+	fwrite(str.data(), 1, length, _file);
+}
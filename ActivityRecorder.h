@@ -0,0 +1,43 @@
+#ifndef __ActivityRecorder_h__
+#define __ActivityRecorder_h__
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "MetricRegistry.h"
+
+using namespace std;
+
+//
+// Recording file layout, in native byte order:
+//   header  - "PCAR", uint32 version, uint32 metric count, then per metric its
+//             name and unit (each a uint8 length and the characters) and uint8 precision
+//   samples - int64 nanoseconds since the recording started, then one float per metric
+//
+static const char recordingMagic[4] = { 'P', 'C', 'A', 'R' };
+static const uint32_t recordingVersion = 2;
+
+struct RecordingHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t metricCount;
+};
+
+// Writes timestamped snapshots of every registered metric to a recording file
+class ActivityRecorder {
+	FILE* _file = nullptr;
+	int _metricCount = 0;
+	chrono::steady_clock::time_point _start;
+
+	void write_string(const string &str);
+
+  public:
+	ActivityRecorder(const string &path, const MetricRegistry &registry);
+	~ActivityRecorder();
+	bool is_open();
+	void record(const MetricRegistry &registry);
+};
+
+#endif
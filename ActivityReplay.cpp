@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <iostream>
+#include <string.h>
+
+#include "ActivityReplay.h"
+
+using namespace std;
+
+// The whole recording is loaded up front, so playback never touches the disk
+ActivityReplay::ActivityReplay(const string &path, bool realTime) : _realTime(realTime) {
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file) {
+		cout << "Opening recording " << path << " failed: " << strerror(errno) << endl;
+		return;
+	}
+	RecordingHeader header;
+	if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, recordingMagic, sizeof(header.magic)) != 0) {
+		cout << path << " is not a recording" << endl;
+		fclose(file);
+		return;
+	}
+	if (header.version != recordingVersion) {
+		cout << "Unsupported recording version " << header.version << endl;
+		fclose(file);
+		return;
+	}
+	for (uint32_t i = 0; i < header.metricCount; ++i) {
+		MetricInfo info;
+		uint8_t precision;
+		if (!read_string(file, info.name) || !read_string(file, info.unit)
+		    || fread(&precision, sizeof(precision), 1, file) != 1) {
+			cout << "Recording " << path << " has a truncated header" << endl;
+			_metrics.clear();
+			fclose(file);
+			return;
+		}
+		info.precision = precision;
+		_metrics.push_back(info);
+	}
+	int64_t timestamp;
+	vector<float> values(_metrics.size());
+	while (fread(&timestamp, sizeof(timestamp), 1, file) == 1
+	       && fread(values.data(), sizeof(float), values.size(), file) == values.size()) {
+		_timestamps.push_back(timestamp);
+		_values.insert(_values.end(), values.begin(), values.end());
+	}
+	fclose(file);
+
+	// Real time playback is polled as often as the closest recorded samples, fast playback every tick
+	_period = _realTime ? defaultSamplePeriod : chrono::milliseconds(0);
+	for (size_t i = 1; _realTime && i < _timestamps.size(); ++i) {
+		auto gap = chrono::duration_cast<chrono::milliseconds>(chrono::nanoseconds(_timestamps[i] - _timestamps[i - 1]));
+		if (gap.count() > 0) {
+			_period = min(_period, gap);
+		}
+	}
+	cout << "Replaying " << _timestamps.size() << " samples of " << _metrics.size() << " metrics from " << path << endl;
+}
+
+size_t ActivityReplay::sample_count() {
+	return _timestamps.size();
+}
+
+void ActivityReplay::rewind() {
+	_next = 0;
+	_started = false;
+}
+
+vector<MetricInfo> ActivityReplay::metrics() {
+	return _metrics;
+}
+
+chrono::milliseconds ActivityReplay::sample_period() {
+	return _period;
+}
+
+int ActivityReplay::sample_cost_us() {
+	return 1;
+}
+
+void ActivityReplay::sample(float* values) {
+	if (_timestamps.empty()) {
+		return;
+	}
+	if (!_started) {
+		_start = chrono::steady_clock::now();
+		_started = true;
+	}
+	size_t current = _next;
+	if (_realTime) {
+		// Latest sample whose offset into the recording has been reached, give or take
+		// half a poll so scheduling jitter does not hold a sample back a whole period
+		current = (_next > 0) ? _next - 1 : 0;
+		auto elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - _start + _period / 2).count();
+		while (current + 1 < _timestamps.size() && _timestamps[current + 1] - _timestamps[0] <= elapsed) {
+			++current;
+		}
+	}
+	current = min(current, _timestamps.size() - 1);
+	copy_n(&_values[current * _metrics.size()], _metrics.size(), values);
+	_next = current + 1;
+}
+
+bool ActivityReplay::finished() {
+	return _next >= _timestamps.size();
+}
+
+//
+// Private methods
+//
+
+bool ActivityReplay::read_string(FILE* file, string &str) {
+	uint8_t length;
+	if (fread(&length, sizeof(length), 1, file) != 1) {
+		return false;
+	}
+	str.resize(length);
+	return fread(&str[0], 1, length, file) == length;
+}
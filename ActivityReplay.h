@@ -0,0 +1,40 @@
+#ifndef __ActivityReplay_h__
+#define __ActivityReplay_h__
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "ActivityRecorder.h"
+#include "MetricSource.h"
+
+using namespace std;
+
+// Plays back a file written by ActivityRecorder as a metric source, publishing the recorded
+// metrics under their original names, at the recorded pace or one sample per tick
+class ActivityReplay : public MetricSource {
+	vector<MetricInfo> _metrics;
+	vector<int64_t> _timestamps;
+	vector<float> _values;        // _metrics.size() per sample
+	size_t _next = 0;             // next sample to hand out
+	bool _realTime;
+	chrono::milliseconds _period = defaultSamplePeriod;
+	bool _started = false;
+	chrono::steady_clock::time_point _start;
+
+	bool read_string(FILE* file, string &str);
+
+  public:
+	ActivityReplay(const string &path, bool realTime);
+	size_t sample_count();
+	// Starts again from the first sample
+	void rewind();
+
+	vector<MetricInfo> metrics() override;
+	chrono::milliseconds sample_period() override;
+	int sample_cost_us() override;
+	void sample(float* values) override;
+	bool finished() override;
+};
+
+#endif
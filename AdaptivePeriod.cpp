@@ -0,0 +1,48 @@
+#include <algorithm>
+#include <cmath>
+
+#include "AdaptivePeriod.h"
+
+using namespace std;
+
+// Weight of the newest sample in the running mean and variance
+static const float weight = 0.25f;
+
+static const chrono::milliseconds slack(10);
+
+AdaptivePeriod::AdaptivePeriod(const AdaptiveRange &range)
+	: _minPeriod(range.minPeriod), _maxPeriod(max(range.minPeriod, range.maxPeriod)), _period(_maxPeriod),
+	  _threshold(range.threshold) {
+}
+
+bool AdaptivePeriod::due(chrono::steady_clock::time_point now) const {
+	return now + slack >= _due;
+}
+
+void AdaptivePeriod::update(float value, chrono::steady_clock::time_point now) {
+	if (!_primed) {
+		_mean = _last = value;
+		_primed = true;
+	}
+	float change = fabs(value - _last);
+	float deviation = value - _mean;
+	_mean += weight * deviation;
+	_variance = (1 - weight) * (_variance + weight * deviation * deviation);
+	_last = value;
+
+	if (change >= _threshold) {
+		_period = _minPeriod;
+	}
+	else if (change < _threshold / 2 && sqrt(_variance) < _threshold / 2) {
+		_period = min(_maxPeriod, _period * 2);
+	}
+	_due = now + _period;
+}
+
+chrono::steady_clock::time_point AdaptivePeriod::next_due() const {
+	return _due;
+}
+
+chrono::milliseconds AdaptivePeriod::period() const {
+	return _period;
+}
@@ -0,0 +1,41 @@
+#ifndef __AdaptivePeriod_h__
+#define __AdaptivePeriod_h__
+
+#include <chrono>
+#include <string>
+
+using namespace std;
+
+// Sample period limits for one metric, and how much change counts as a burst, in the
+// metric's own units
+struct AdaptiveRange {
+	string metric;
+	chrono::milliseconds minPeriod;
+	chrono::milliseconds maxPeriod;
+	float threshold;
+};
+
+// Picks the sample period of one metric from how much it is moving. A change of at least
+// the threshold since the previous sample drops straight to the minimum period, to follow
+// the burst. Once samples are flat, with small changes and a small spread, the period
+// doubles on each sample up to the maximum.
+class AdaptivePeriod {
+	chrono::milliseconds _minPeriod, _maxPeriod, _period;
+	float _threshold;
+	bool _primed = false;
+	float _last = 0;
+	// Exponentially weighted mean and variance of the recent samples
+	float _mean = 0;
+	float _variance = 0;
+	chrono::steady_clock::time_point _due;
+
+  public:
+	AdaptivePeriod(const AdaptiveRange &range);
+	// Due within a little slack, so a wake-up a moment early does not skip the sample
+	bool due(chrono::steady_clock::time_point now) const;
+	void update(float value, chrono::steady_clock::time_point now);
+	chrono::steady_clock::time_point next_due() const;
+	chrono::milliseconds period() const;
+};
+
+#endif
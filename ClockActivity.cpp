@@ -0,0 +1,27 @@
+#include <ctime>
+
+#include "ClockActivity.h"
+
+using namespace std;
+
+vector<MetricInfo> ClockActivity::metrics() {
+	return { {"clock.hour12", "", 0}, {"clock.minute_tens", "", 0}, {"clock.minute_ones", "", 0} };
+}
+
+int ClockActivity::sample_cost_us() {
+	return 1;
+}
+
+void ClockActivity::sample(float* values) {
+	time_t curTime = time(NULL);
+	tm local;
+#ifdef _WIN32
+	localtime_s(&local, &curTime);
+#else
+	// glibc's localtime() reads TZ again on every call, copying it with strdup()
+	localtime_r(&curTime, &local);
+#endif
+	values[0] = local.tm_hour % 12;
+	values[1] = local.tm_min / 10;
+	values[2] = local.tm_min % 10;
+}
@@ -0,0 +1,16 @@
+#ifndef __ClockActivity_h__
+#define __ClockActivity_h__
+
+#include "MetricSource.h"
+
+using namespace std;
+
+// Local time of day, split into the digits shown in binary on the fans
+class ClockActivity : public MetricSource {
+  public:
+	vector<MetricInfo> metrics() override;
+	int sample_cost_us() override;
+	void sample(float* values) override;
+};
+
+#endif
@@ -1,24 +1,189 @@
 #include <iostream>
 #include <iomanip>
 #include <math.h>
+#ifndef _WIN32
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <unistd.h>
+#endif
 
 extern "C" {
 	#include "nvml.h"
 }
 
 #include "ComputerActivity.h"
+#include "Trace.h"
 
 using namespace std;
 
-ComputerActivity::ComputerActivity() {
+// Memory moves slowly and is worth less attention than CPU and GPU, which burst
+static const AdaptiveRange defaultPeriods[] = {
+	{ "memory.usage", chrono::milliseconds(1000), chrono::milliseconds(10000), 2 },
+	{ "cpu.load",     chrono::milliseconds(500),  chrono::milliseconds(5000),  5 },
+	{ "gpu.load",     chrono::milliseconds(500),  chrono::milliseconds(5000),  5 },
+};
+
+#ifndef _WIN32
+// Where the CPU's time went, in the order of the CpuTimes fields after idle is taken out
+static const char* cpuBreakdown[] = { "user", "nice", "system", "irq", "softirq", "iowait", "steal" };
+static const int cpuBreakdownCount = sizeof(cpuBreakdown) / sizeof(cpuBreakdown[0]);
+#endif
+
+static AdaptiveRange period_for(const AdaptiveRange &defaults, const vector<AdaptiveRange> &periods) {
+	for (const auto &range : periods) {
+		if (range.metric == defaults.metric) {
+			return range;
+		}
+	}
+	return defaults;
+}
+
+ComputerActivity::ComputerActivity(const string &cgroupPath, const vector<AdaptiveRange> &periods, bool ioUring,
+                                   bool subtractSelf)
+	: _memoryPeriod(period_for(defaultPeriods[0], periods)), _cpuPeriod(period_for(defaultPeriods[1], periods)),
+	  _gpuPeriod(period_for(defaultPeriods[2], periods)), _self(subtractSelf ? new SelfActivity() : nullptr)
+#ifndef _WIN32
+	, _batch(ioUring)
+#endif
+{
 	cout << "Initializing NVML..." << endl;
 	auto rc = nvmlInit();
 	if (rc != NVML_SUCCESS) {
 		cout << "Initializing NVML library failed: " << nvmlErrorString(rc) << endl;
 	}
+#ifdef _WIN32
+	if (!cgroupPath.empty()) {
+		cout << "cgroups are Linux only, showing the whole machine" << endl;
+	}
+	if (ioUring) {
+		cout << "io_uring is Linux only" << endl;
+	}
+#else
+	if (!_stat.is_open() || !_meminfo.is_open()) {
+		cout << "Opening procfs failed, CPU and memory usage will read as 0" << endl;
+	}
+	// One parse up front finds how many cores there are, and sizes both snapshots for them
+	const char* stat = _stat.read();
+	if (stat && parse_proc_stat(stat, _procStat)) {
+		_coreMetrics = static_cast<int>(_procStat.cores.size());
+		_previousStat = _procStat;
+	}
+	if (!cgroupPath.empty()) {
+		// Paths are under the cgroup2 mount, as in /proc/<pid>/cgroup, unless they are the
+		// full path of a cgroup
+		string path = cgroupPath[0] == '/' && access((cgroupPath + "/cpu.stat").c_str(), R_OK) == 0
+			? cgroupPath : "/sys/fs/cgroup/" + cgroupPath.substr(cgroupPath[0] == '/' ? 1 : 0);
+		_cgroup.reset(new Cgroup(path));
+		if (!_cgroup->cpuStat.is_open()) {
+			cout << "No cgroup v2 at " << path << ", showing the whole machine" << endl;
+			_cgroup.reset();
+		}
+		else if (!_cgroup->memoryCurrent.is_open() || !_cgroup->ioStat.is_open()) {
+			cout << "The memory or io controller is not enabled for " << path << ", those will read as 0" << endl;
+		}
+	}
+#endif
+}
+
+vector<MetricInfo> ComputerActivity::metrics() {
+	vector<MetricInfo> infos = { {"memory.usage", "%", 0}, {"cpu.load", "%", 0}, {"gpu.load", "%", 0} };
+#ifndef _WIN32
+	infos.push_back({"cpu.context_switches", "/s", 0});
+	infos.push_back({"cpu.interrupts", "/s", 0});
+	infos.push_back({"cpu.procs_running", "", 0});
+	infos.push_back({"cpu.procs_blocked", "", 0});
+	for (int core = 0; core < _coreMetrics; ++core) {
+		infos.push_back({"cpu." + to_string(core) + ".load", "%", 0});
+	}
+	// The breakdowns are of the whole machine, so they are left out for a cgroup
+	if (!_cgroup) {
+		for (const char* name : cpuBreakdown) {
+			infos.push_back({string("cpu.") + name, "%", 1});
+		}
+		infos.push_back({"memory.used", "%", 1});
+		infos.push_back({"memory.cache", "%", 1});
+		infos.push_back({"memory.free", "%", 1});
+	}
+	else {
+		infos.push_back({"cgroup.memory.current", " MiB", 0});
+		infos.push_back({"cgroup.io.read", " MB/s", 1});
+		infos.push_back({"cgroup.io.write", " MB/s", 1});
+		infos.push_back({"cgroup.cpu.pressure", "%", 1});
+	}
+#endif
+	return infos;
+}
+
+// Two procfs reads (or Win32 calls) and an NVML query
+int ComputerActivity::sample_cost_us() {
+	return 50;
+}
+
+// Until every metric has had a first sample this is the shortest current period, then
+// the time until the next one is due
+chrono::milliseconds ComputerActivity::sample_period() {
+	auto next = min(_memoryPeriod.next_due(), min(_cpuPeriod.next_due(), _gpuPeriod.next_due()));
+	if (next.time_since_epoch().count() == 0) {
+		return min(_memoryPeriod.period(), min(_cpuPeriod.period(), _gpuPeriod.period()));
+	}
+	return max(chrono::milliseconds(1), chrono::ceil<chrono::milliseconds>(next - chrono::steady_clock::now()));
 }
 
+// Each metric keeps its own schedule, so an early or late sample must not shift the next
+bool ComputerActivity::period_from_now() {
+	return true;
+}
+
+// Metrics that are not due keep their previous values in the registry's snapshot
+void ComputerActivity::sample(float* values) {
+	auto now = chrono::steady_clock::now();
+	bool memoryDue = _memoryPeriod.due(now);
+	bool cpuDue = _cpuPeriod.due(now);
+#ifndef _WIN32
+	batch_reads(memoryDue, cpuDue);
+#endif
+	if (memoryDue) {
+		values[0] = get_memory_usage();
+		_memoryPeriod.update(values[0], now);
+#ifndef _WIN32
+		// After the per-core loads come the cgroup extras, or the two breakdowns
+		if (_cgroup) {
+			sample_cgroup_extras(values + 7 + _coreMetrics);
+		}
+		else {
+			sample_memory_breakdown(values + 7 + _coreMetrics + cpuBreakdownCount);
+		}
+#endif
+	}
+	if (cpuDue) {
+		values[1] = get_cpu_load();
+		_cpuPeriod.update(values[1], now);
+		if (_self) {
+			// Over the same interval as the load, so it is taken off once per CPU sample
+			_self->sample();
+			values[1] = max(0.0f, roundf(values[1] - _self->get_cpu_load()));
+		}
+#ifndef _WIN32
+		sample_stat_extras(values + 3);
+		if (!_cgroup) {
+			sample_cpu_breakdown(values + 7 + _coreMetrics, _self ? _self->get_cpu_load() : 0);
+		}
+#endif
+	}
+#ifndef _WIN32
+	_batch.clear();
+#endif
+	if (_gpuPeriod.due(now)) {
+		values[2] = get_gpu_load();
+		_gpuPeriod.update(values[2], now);
+	}
+}
+
+#ifdef _WIN32
 int ComputerActivity::get_memory_usage() {
+	TRACE_SCOPE("memory");
 	MEMORYSTATUSEX memInfo;
 	memInfo.dwLength = sizeof(MEMORYSTATUSEX);
 	GlobalMemoryStatusEx(&memInfo);
@@ -28,26 +193,58 @@ int ComputerActivity::get_memory_usage() {
 //	cout << "totalVirtualMem = " << totalVirtualMem / (1024 * 1024 * 1024) << " GiB" << endl;
 	return static_cast<int> (usedVirtualMem * 100 / totalVirtualMem);
 }
+#else
+static unsigned long long meminfo_value(const char *buf, const char *key) {
+	const char *pos = strstr(buf, key);
+	return pos ? strtoull(pos + strlen(key), nullptr, 10) : 0;
+}
+
+// Mirrors the Windows commit charge: RAM plus swap, in use against the total of both
+int ComputerActivity::get_memory_usage() {
+	TRACE_SCOPE("memory");
+	if (_cgroup) {
+		return cgroup_memory_usage();
+	}
+	const char *buf = _meminfo.read();
+	if (!buf) {
+		return 0;
+	}
+	// Kept for sample_memory_breakdown(), which reads the same snapshot
+	_memTotalKb = meminfo_value(buf, "MemTotal:");
+	_memFreeKb = meminfo_value(buf, "MemFree:");
+	_memCacheKb = meminfo_value(buf, "Buffers:") + meminfo_value(buf, "Cached:") + meminfo_value(buf, "SReclaimable:");
+	unsigned long long total = _memTotalKb + meminfo_value(buf, "SwapTotal:");
+	unsigned long long avail = meminfo_value(buf, "MemAvailable:") + meminfo_value(buf, "SwapFree:");
+	if (total == 0 || avail > total) {
+		return 0;
+	}
+	return static_cast<int> ((total - avail) * 100 / total);
+}
+#endif
 
 //
 // CPU usage
 //   Thanks - https://stackoverflow.com/questions/23143693/retrieving-cpu-load-percent-total-in-windows-with-c
 // 
 float ComputerActivity::calculate_cpu_load(unsigned long long idleTicks, unsigned long long totalTicks) {
-   unsigned long long totalTicksSinceLastTime = totalTicks - this->_previousTotalTicks;
-   unsigned long long idleTicksSinceLastTime  = idleTicks - this->_previousIdleTicks;
+   unsigned long long totalTicksSinceLastTime = counter_delta(totalTicks, this->_previousTotalTicks);
+   unsigned long long idleTicksSinceLastTime  = counter_delta(idleTicks, this->_previousIdleTicks);
 
-   float ret = 1.0f - ((totalTicksSinceLastTime > 0) ? ((float)idleTicksSinceLastTime) / totalTicksSinceLastTime : 0);
+   // Shares of ticks rather than of time, so this holds however long the interval was
+   float ret = delta_share(idleTicksSinceLastTime <= totalTicksSinceLastTime
+                           ? totalTicksSinceLastTime - idleTicksSinceLastTime : 0, totalTicksSinceLastTime) / 100;
    this->_previousTotalTicks = totalTicks;
    this->_previousIdleTicks  = idleTicks;
    return ret;
 }
 
+#ifdef _WIN32
 unsigned long long ComputerActivity::file_time_to_int64(const FILETIME & ft) {
 	return (((unsigned long long)(ft.dwHighDateTime))<<32)|((unsigned long long)ft.dwLowDateTime);
 }
 
 int ComputerActivity::get_cpu_load() {
+   TRACE_SCOPE("cpu");
    FILETIME idleTime, kernelTime, userTime;
    int loadPct = 0;
    if (GetSystemTimes(&idleTime, &kernelTime, &userTime)) {
@@ -57,6 +254,215 @@ int ComputerActivity::get_cpu_load() {
    }
    return loadPct;
 }
+#else
+// The cpu line is the aggregate of all cores. The rest of /proc/stat is parsed in the
+// same pass, for sample_stat_extras().
+int ComputerActivity::get_cpu_load() {
+	TRACE_SCOPE("cpu");
+	const char *pos = _stat.read();
+	_previousStat = _procStat;
+	if (!pos || !parse_proc_stat(pos, _procStat)) {
+		return 0;
+	}
+	_statClock.advance(_stat.read_time());
+	if (_cgroup) {
+		return cgroup_cpu_load();
+	}
+	return static_cast<int>(floor(100 * calculate_cpu_load(_procStat.total.idle_ticks(), _procStat.total.total_ticks())));
+}
+
+void ComputerActivity::sample_stat_extras(float* values) {
+	if (_statClock.ready()) {
+		values[0] = _statClock.rate(_procStat.contextSwitches, _previousStat.contextSwitches);
+		values[1] = _statClock.rate(_procStat.interrupts, _previousStat.interrupts);
+	}
+	values[2] = static_cast<float>(_procStat.procsRunning);
+	values[3] = static_cast<float>(_procStat.procsBlocked);
+	for (int core = 0; core < _coreMetrics; ++core) {
+		const CpuTimes &now = _procStat.cores[core];
+		const CpuTimes &before = _previousStat.cores[core];
+		unsigned long long total = counter_delta(now.total_ticks(), before.total_ticks());
+		unsigned long long idle = counter_delta(now.idle_ticks(), before.idle_ticks());
+		bool online = _procStat.online[core] && _previousStat.online[core];
+		values[4 + core] = online ? delta_share(idle <= total ? total - idle : 0, total) : 0;
+	}
+}
+
+// Shares of the ticks since the previous parse, which with idle add up to 100. The CPU
+// bar shows these, so selfLoad comes off them as it does off cpu.load: off user time
+// first, as most of the monitor's time is, and what is left off system time.
+void ComputerActivity::sample_cpu_breakdown(float* values, float selfLoad) {
+	const CpuTimes &now = _procStat.total;
+	const CpuTimes &before = _previousStat.total;
+	unsigned long long total = counter_delta(now.total_ticks(), before.total_ticks());
+	if (!_statClock.ready() || total == 0) {
+		return;
+	}
+	const unsigned long long CpuTimes::*fields[] = { &CpuTimes::user, &CpuTimes::nice, &CpuTimes::system,
+	                                                 &CpuTimes::irq, &CpuTimes::softirq, &CpuTimes::iowait,
+	                                                 &CpuTimes::steal };
+	for (int field = 0; field < cpuBreakdownCount; ++field) {
+		values[field] = delta_share(counter_delta(now.*fields[field], before.*fields[field]), total);
+	}
+	float fromUser = min(selfLoad, values[0]);
+	values[0] -= fromUser;
+	values[2] = max(0.0f, values[2] - (selfLoad - fromUser));
+}
+
+// Of RAM alone, as free(1) splits it: cache is the buffers, page cache and reclaimable
+// slab, used is what is left once that and free are taken out
+void ComputerActivity::sample_memory_breakdown(float* values) {
+	if (_memTotalKb == 0 || _memFreeKb + _memCacheKb > _memTotalKb) {
+		return;
+	}
+	values[0] = 100.0f * (_memTotalKb - _memFreeKb - _memCacheKb) / _memTotalKb;
+	values[1] = 100.0f * _memCacheKb / _memTotalKb;
+	values[2] = 100.0f * _memFreeKb / _memTotalKb;
+}
+
+// Every file the due metrics parse on each sample. Files only read some of the time,
+// such as cpuset.cpus.effective, are left to pread.
+void ComputerActivity::batch_reads(bool memory, bool cpu) {
+	if (!_batch.uses_io_uring()) {
+		return;
+	}
+	if (memory) {
+		if (_cgroup) {
+			_batch.add(_cgroup->memoryCurrent);
+			_batch.add(_cgroup->memoryMax);
+			_batch.add(_cgroup->ioStat);
+			_batch.add(_cgroup->cpuPressure);
+		}
+		else {
+			_batch.add(_meminfo);
+		}
+	}
+	if (cpu) {
+		_batch.add(_stat);
+		if (_cgroup) {
+			_batch.add(_cgroup->cpuStat);
+			_batch.add(_cgroup->cpuMax);
+		}
+	}
+	_batch.read();
+}
+
+//
+// cgroup v2
+//
+
+ComputerActivity::Cgroup::Cgroup(const string &path)
+	: cpuStat(path + "/cpu.stat", 1024), cpuMax(path + "/cpu.max", 64),
+	  cpusEffective(path + "/cpuset.cpus.effective", 256), memoryCurrent(path + "/memory.current", 64),
+	  memoryMax(path + "/memory.max", 64), ioStat(path + "/io.stat", 4096), cpuPressure(path + "/cpu.pressure", 256) {
+}
+
+// memory.max is "max" for no limit, then the group can use all of RAM
+int ComputerActivity::cgroup_memory_usage() {
+	const char* pos = _cgroup->memoryCurrent.read();
+	if (!pos) {
+		_cgroup->currentBytes = 0;
+		return 0;
+	}
+	unsigned long long current = parse_uint(pos);
+	_cgroup->currentBytes = current;
+	const char* max = _cgroup->memoryMax.read();
+	unsigned long long limit = max && *max >= '0' && *max <= '9' ? parse_uint(max) : memory_total();
+	return limit > 0 ? static_cast<int>(min(100ULL, current * 100 / limit)) : 0;
+}
+
+// cpu.stat starts "usage_usec N", the CPU time of every task in the group
+int ComputerActivity::cgroup_cpu_load() {
+	const char* pos = _cgroup->cpuStat.read();
+	if (!pos || strncmp(pos, "usage_usec ", 11) != 0) {
+		return 0;
+	}
+	pos += 11;
+	unsigned long long usageUs = parse_uint(pos);
+	_cgroup->cpuClock.advance(_cgroup->cpuStat.read_time());
+	// Microseconds of CPU per second, so 1e6 is one CPU kept busy
+	double usage = _cgroup->cpuClock.rate(usageUs, _cgroup->previousUsageUs);
+	_cgroup->previousUsageUs = usageUs;
+	if (!_cgroup->cpuClock.ready()) {
+		return 0;
+	}
+	return static_cast<int>(min(100.0, floor(100 * usage / (1e6 * cgroup_cpu_count()))));
+}
+
+// CPUs the group may use: its cpu.max quota ("quota period", or "max period" for none)
+// if it has one, or else the CPUs of its cpuset ("0-3,8,10-11")
+float ComputerActivity::cgroup_cpu_count() {
+	const char* pos = _cgroup->cpuMax.read();
+	if (pos && *pos >= '0' && *pos <= '9') {
+		unsigned long long quota = parse_uint(pos);
+		unsigned long long period = parse_uint(pos);
+		if (quota > 0 && period > 0) {
+			return static_cast<float>(quota) / period;
+		}
+	}
+	int cpus = 0;
+	pos = _cgroup->cpusEffective.read();
+	while (pos && *pos >= '0' && *pos <= '9') {
+		unsigned long long first = parse_uint(pos);
+		unsigned long long last = first;
+		if (*pos == '-') {
+			++pos;
+			last = parse_uint(pos);
+		}
+		cpus += static_cast<int>(last - first + 1);
+		if (*pos == ',') {
+			++pos;
+		}
+	}
+	return cpus > 0 ? cpus : max(1u, thread::hardware_concurrency());
+}
+
+// io.stat has a line per device: "259:0 rbytes=N wbytes=N rios=N wios=N dbytes=N dios=N"
+void ComputerActivity::sample_cgroup_extras(float* values) {
+	// memory.current as cgroup_memory_usage() read it, just before
+	values[0] = _cgroup->currentBytes / (1024.0f * 1024.0f);
+
+	const char* pos = _cgroup->ioStat.read();
+	if (pos) {
+		unsigned long long readBytes = 0, writtenBytes = 0;
+		while (*pos) {
+			const char* end = next_line(pos);
+			for (const char* field = pos; field < end; ++field) {
+				if (strncmp(field, " rbytes=", 8) == 0) {
+					field += 8;
+					readBytes += parse_uint(field);
+				}
+				else if (strncmp(field, " wbytes=", 8) == 0) {
+					field += 8;
+					writtenBytes += parse_uint(field);
+				}
+			}
+			pos = end;
+		}
+		// Devices drop out of io.stat when they are removed, which makes the sums go
+		// backwards like a reset
+		_cgroup->ioClock.advance(_cgroup->ioStat.read_time());
+		if (_cgroup->ioClock.ready()) {
+			values[1] = _cgroup->ioClock.rate(readBytes, _cgroup->previousReadBytes) / 1e6;
+			values[2] = _cgroup->ioClock.rate(writtenBytes, _cgroup->previousWrittenBytes) / 1e6;
+		}
+		_cgroup->previousReadBytes = readBytes;
+		_cgroup->previousWrittenBytes = writtenBytes;
+	}
+
+	// "some avg10=1.70 avg60=3.94 avg300=2.11 total=30430017"
+	pos = _cgroup->cpuPressure.read();
+	if (pos && strncmp(pos, "some avg10=", 11) == 0) {
+		pos += 11;
+		values[3] = parse_decimal(pos);
+	}
+}
+
+unsigned long long ComputerActivity::memory_total() {
+	const char* buf = _meminfo.read();
+	return buf ? meminfo_value(buf, "MemTotal:") * 1024 : 0;
+}
+#endif
 
 //
 // GPU usage - Using NVIDIA CUDA API to get GPU usage
@@ -65,6 +471,7 @@ int ComputerActivity::get_cpu_load() {
 //     https://docs.nvidia.com/deploy/pdf/NVML_API_Reference_Guide.pdf
 //
 int ComputerActivity::get_gpu_load() {
+	TRACE_SCOPE("gpu (nvml)");
 	unsigned int deviceCount;
 	nvmlReturn_t rc;
 	if (NVML_SUCCESS != nvmlDeviceGetCount(&deviceCount)) {
@@ -1,24 +1,100 @@
 #ifndef __ComputerActivity_h__
 #define __ComputerActivity_h__
 
+#ifdef _WIN32
 #include "windows.h"
+#endif
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "AdaptivePeriod.h"
+#include "MetricSource.h"
+#include "ProcFile.h"
+#include "ProcStat.h"
+#include "Rate.h"
+#include "ReadBatch.h"
+#include "SelfActivity.h"
 
 using namespace std;
 
-class ComputerActivity {
+// System-wide memory, CPU and GPU load. On Linux it also publishes the load of each
+// core, context switches and interrupts per second and the run queue, all from one
+// parse of /proc/stat per sample, and where the CPU time and RAM went: cpu.user through
+// cpu.steal and memory.used, memory.cache and memory.free, each as a share of the whole.
+//
+// On Linux it can be scoped to one cgroup v2 instead, such as a service's slice or a
+// container, where CPU load is against the CPUs the group may use and memory against
+// its limit. That mode also publishes the group's I/O, memory and CPU pressure as cgroup.*.
+class ComputerActivity : public MetricSource {
+	// Memory, CPU and GPU are each sampled as often as they are changing, the per-core
+	// and other /proc/stat metrics with the CPU and the cgroup extras with memory
+	AdaptivePeriod _memoryPeriod, _cpuPeriod, _gpuPeriod;
+
 	// Used for calculating running CPU totals
 	unsigned long long _previousTotalTicks = 0;
     unsigned long long _previousIdleTicks = 0;
+	// With subtractSelf, the monitor's own CPU time, read at each CPU sample
+	unique_ptr<SelfActivity> _self;
 
-	// Support CPU calculations
-	float calculate_cpu_load(unsigned long long, unsigned long long);
+#ifdef _WIN32
 	unsigned long long file_time_to_int64(const FILETIME &);
+#else
+	ProcFile _stat{"/proc/stat", 64 * 1024};
+	ProcFile _meminfo{"/proc/meminfo"};
+	// Reads the files of the metrics due in one go, before they are parsed
+	ReadBatch _batch;
+	// The latest parse of /proc/stat and the one before, for the per-core and rate metrics
+	ProcStat _procStat;
+	ProcStat _previousStat;
+	RateClock _statClock;
+	int _coreMetrics = 0;
+	// RAM from the latest read of /proc/meminfo, in kB
+	unsigned long long _memTotalKb = 0, _memFreeKb = 0, _memCacheKb = 0;
+
+	// The cgroup's files, kept open like the procfs ones
+	struct Cgroup {
+		ProcFile cpuStat, cpuMax, cpusEffective, memoryCurrent, memoryMax, ioStat, cpuPressure;
+		unsigned long long currentBytes = 0;
+		unsigned long long previousUsageUs = 0;
+		unsigned long long previousReadBytes = 0, previousWrittenBytes = 0;
+		RateClock cpuClock, ioClock;
+		Cgroup(const string &path);
+	};
+	unique_ptr<Cgroup> _cgroup;
+
+	int cgroup_memory_usage();
+	int cgroup_cpu_load();
+	float cgroup_cpu_count();
+	void sample_stat_extras(float* values);
+	void sample_cpu_breakdown(float* values, float selfLoad);
+	void sample_memory_breakdown(float* values);
+	void sample_cgroup_extras(float* values);
+	void batch_reads(bool memory, bool cpu);
+	unsigned long long memory_total();
+#endif
 
   public:
-	ComputerActivity();
+	// An empty cgroupPath measures the whole machine. periods replaces the default range
+	// of any of memory.usage, cpu.load and gpu.load it names. ioUring reads the procfs and
+	// cgroup files of each sample as one io_uring batch, on Linux where it is available.
+	// subtractSelf takes the monitor's own CPU time out of cpu.load and the breakdown.
+	ComputerActivity(const string &cgroupPath = "", const vector<AdaptiveRange> &periods = {}, bool ioUring = false,
+	                 bool subtractSelf = false);
 	int get_memory_usage();
 	int get_cpu_load();
 	int get_gpu_load();
+
+	vector<MetricInfo> metrics() override;
+	chrono::milliseconds sample_period() override;
+	bool period_from_now() override;
+	int sample_cost_us() override;
+	void sample(float* values) override;
+
+	// Support CPU calculations, public so the benchmarks can time it on its own
+	float calculate_cpu_load(unsigned long long, unsigned long long);
 };
 
 #endif
@@ -0,0 +1,32 @@
+#include "ClockActivity.h"
+#include "ComputerActivity.h"
+#include "DefaultSources.h"
+#include "DiskActivity.h"
+#include "FrequencyActivity.h"
+#include "HwmonActivity.h"
+#include "NetworkActivity.h"
+#include "NumaActivity.h"
+#include "PerfActivity.h"
+#include "PressureActivity.h"
+#include "ProcessActivity.h"
+#include "SelfActivity.h"
+#include "VmstatActivity.h"
+
+void register_default_sources(MetricRegistry &registry, const SourceOptions &options) {
+	registry.add(new ComputerActivity(options.cgroup, options.periods, options.ioUring, options.subtractSelf));
+	registry.add(new SelfActivity());
+	registry.add(new ClockActivity());
+#ifndef _WIN32
+	registry.add(new DiskActivity());
+	registry.add(new FrequencyActivity());
+	registry.add(new HwmonActivity());
+	registry.add(new NetworkActivity(options.netInclude, options.netExclude, "/proc", "/sys", options.netVirtualTotals));
+	registry.add(new NumaActivity(options.memoryModules, options.numaModules));
+	registry.add(new PerfActivity());
+	registry.add(new PressureActivity());
+	if (options.topProcesses > 0) {
+		registry.add(new ProcessActivity(options.topProcesses));
+	}
+	registry.add(new VmstatActivity());
+#endif
+}
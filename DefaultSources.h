@@ -0,0 +1,40 @@
+#ifndef __DefaultSources_h__
+#define __DefaultSources_h__
+
+#include <string>
+#include <vector>
+
+#include "AdaptivePeriod.h"
+#include "MetricRegistry.h"
+
+using namespace std;
+
+// Settings of the sources that have any, filled in from the command line
+struct SourceOptions {
+	// Network interfaces to watch, by name or a prefix ending in '*'. Empty includes all.
+	vector<string> netInclude;
+	vector<string> netExclude = {"lo"};
+	// Count virtual interfaces, such as veths and bridges, in the network totals
+	bool netVirtualTotals = false;
+	// cgroup v2 to measure CPU and memory of instead of the whole machine, empty for none
+	string cgroup;
+	// Busiest processes to show, 0 to not scan them. Off unless asked for, as a scan of a
+	// host with tens of thousands of processes costs tens of milliseconds.
+	int topProcesses = 0;
+	// Read ComputerActivity's procfs files as one io_uring batch per sample
+	bool ioUring = false;
+	// Leave the monitor's own CPU time out of cpu.load
+	bool subtractSelf = false;
+	// Memory modules on the rig, and the NUMA node of each, empty to spread them evenly
+	// over the nodes
+	int memoryModules = 0;
+	vector<int> numaModules;
+	// Sample period ranges replacing the defaults of the metrics they name
+	vector<AdaptiveRange> periods;
+};
+
+// Adds every metric source available on this platform. New sources register here,
+// and become available to the layout by the names of their metrics.
+void register_default_sources(MetricRegistry &registry, const SourceOptions &options = SourceOptions());
+
+#endif
@@ -0,0 +1,179 @@
+#include "DiskActivity.h"
+
+#ifndef _WIN32
+
+#include <algorithm>
+#include <iostream>
+#include <string.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Kernel sectors are always 512 bytes, whatever the device's own sector size
+static const double sectorBytes = 512;
+
+static bool is_name_char(char c) {
+	return c && c != ' ' && c != '\n';
+}
+
+// Disks are the whole block devices in /sys/block, less loop and ram disks. Partitions
+// are left out since their disk already counts their I/O.
+DiskActivity::DiskActivity(const string &procRoot, const string &sysRoot)
+	: _diskstats(procRoot + "/diskstats", 64 * 1024) {
+	const char* pos = _diskstats.read();
+	if (!pos) {
+		cout << "Opening /proc/diskstats failed, disk activity will read as 0" << endl;
+		return;
+	}
+	while (*pos) {
+		const char* line = pos;
+		parse_uint(line);
+		parse_uint(line);
+		line = skip_spaces(line);
+		size_t length = 0;
+		while (is_name_char(line[length])) {
+			++length;
+		}
+		string name(line, length);
+		if (length < sizeof(Disk::name) && name.compare(0, 4, "loop") != 0 && name.compare(0, 3, "ram") != 0
+		    && access((sysRoot + "/block/" + name).c_str(), F_OK) == 0) {
+			Disk disk = {};
+			memcpy(disk.name, line, length);
+			disk.physical = name.compare(0, 3, "dm-") != 0 && name.compare(0, 2, "md") != 0;
+			_disks.push_back(disk);
+		}
+		pos = next_line(pos);
+	}
+}
+
+vector<MetricInfo> DiskActivity::metrics() {
+	vector<MetricInfo> infos = { {"disk.read", " MB/s", 1}, {"disk.write", " MB/s", 1}, {"disk.util", "%", 0} };
+	for (const auto &disk : _disks) {
+		string prefix = string("disk.") + disk.name;
+		infos.push_back({prefix + ".read", " MB/s", 1});
+		infos.push_back({prefix + ".write", " MB/s", 1});
+		infos.push_back({prefix + ".util", "%", 0});
+	}
+	return infos;
+}
+
+// One pread, and a parse of a line per block device
+int DiskActivity::sample_cost_us() {
+	return 20;
+}
+
+void DiskActivity::sample(float* values) {
+	const char* pos = _diskstats.read();
+	if (!pos) {
+		return;
+	}
+	_clock.advance(_diskstats.read_time());
+	bool rates = _clock.ready();
+	++_ticks;
+	float totalRead = 0, totalWritten = 0, busiest = 0;
+
+	// Lines come in the same order every time, so which disk is on which line is worked
+	// out once and each tick only checks the name of the lines it expects a disk on. If
+	// block devices come or go, names stop matching or the number of lines changes, and the
+	// lines are mapped again.
+	bool remap = _remap;
+	_remap = false;
+	if (remap) {
+		_lineDisk.clear();
+	}
+	// Fields after the name: reads, reads merged, sectors read, ms reading, writes, writes
+	// merged, sectors written, ms writing, I/Os in flight, ms doing I/O, ...
+	size_t lineNumber = 0;
+	for (; *pos; ++lineNumber) {
+		const char* line = pos;
+		pos = next_line(pos);
+		if (!remap && (lineNumber >= _lineDisk.size() || _lineDisk[lineNumber] < 0)) {
+			continue;
+		}
+		parse_uint(line);
+		parse_uint(line);
+		line = skip_spaces(line);
+		size_t length = 0;
+		while (is_name_char(line[length])) {
+			++length;
+		}
+		int index;
+		if (remap) {
+			index = find_disk(line, length);
+			_lineDisk.push_back(index);
+		}
+		else {
+			index = _lineDisk[lineNumber];
+			if (strncmp(_disks[index].name, line, length) != 0 || _disks[index].name[length] != '\0') {
+				_remap = true;
+				continue;
+			}
+		}
+		if (index < 0) {
+			continue;
+		}
+		line += length;
+		unsigned long long fields[10];
+		for (auto &field : fields) {
+			field = parse_uint(line);
+		}
+
+		Disk &disk = _disks[index];
+		float *diskValues = values + 3 + 3 * index;
+		if (rates && !disk.missing) {
+			diskValues[0] = _clock.rate(fields[2], disk.sectorsRead) * sectorBytes / 1e6;
+			diskValues[1] = _clock.rate(fields[6], disk.sectorsWritten) * sectorBytes / 1e6;
+			diskValues[2] = _clock.busy_percent(fields[9], disk.ioTicks, 1000);
+			if (disk.physical) {
+				totalRead += diskValues[0];
+				totalWritten += diskValues[1];
+			}
+			busiest = max(busiest, diskValues[2]);
+		}
+		disk.sectorsRead = fields[2];
+		disk.sectorsWritten = fields[6];
+		disk.ioTicks = fields[9];
+		disk.missing = false;
+		disk.readTick = _ticks;
+	}
+	if (lineNumber != _lineDisk.size()) {
+		_remap = true;
+	}
+	// Disks not read on a sample that found the lines moved are an interval behind, so
+	// the sample that maps the lines again only takes their counters
+	if (_remap) {
+		for (auto &disk : _disks) {
+			disk.missing = disk.missing || disk.readTick != _ticks;
+		}
+	}
+
+	// Disks on no line have gone, and their last rates would otherwise stay up
+	if (remap) {
+		for (size_t index = 0; index < _disks.size(); ++index) {
+			if (find(_lineDisk.begin(), _lineDisk.end(), static_cast<int>(index)) == _lineDisk.end()) {
+				fill(values + 3 + 3 * index, values + 6 + 3 * index, 0.0f);
+				_disks[index].missing = true;
+			}
+		}
+	}
+
+	values[0] = totalRead;
+	values[1] = totalWritten;
+	values[2] = busiest;
+}
+
+//
+// Private methods
+//
+
+int DiskActivity::find_disk(const char* name, size_t length) {
+	for (size_t index = 0; index < _disks.size(); ++index) {
+		const char* diskName = _disks[index].name;
+		if (strncmp(diskName, name, length) == 0 && diskName[length] == '\0') {
+			return static_cast<int>(index);
+		}
+	}
+	return -1;
+}
+
+#endif
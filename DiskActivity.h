@@ -0,0 +1,49 @@
+#ifndef __DiskActivity_h__
+#define __DiskActivity_h__
+
+#include <string>
+#include <vector>
+
+#include "MetricSource.h"
+#include "ProcFile.h"
+#include "Rate.h"
+
+using namespace std;
+
+// Throughput and utilization of every whole disk, from /proc/diskstats (Linux only).
+// Publishes totals across physical disks (disk.read, disk.write in MB/s, disk.util as
+// the busiest disk's %util) and the same three per disk, as disk.<name>.read etc.
+//
+// Disks are found once, at start. A disk that goes away reads as 0 until it comes back,
+// and disks added later are only shown after a restart.
+class DiskActivity : public MetricSource {
+	struct Disk {
+		char name[32];
+		bool physical;    // device mapper and md devices sit on top of other disks
+		unsigned long long sectorsRead;
+		unsigned long long sectorsWritten;
+		unsigned long long ioTicks;
+		// No counters to take a rate from: not in the file when the lines were last mapped,
+		// or not read on the sample before, and _ticks when the counters were stored
+		bool missing;
+		unsigned long long readTick;
+	};
+	ProcFile _diskstats;
+	vector<Disk> _disks;
+	// Disk on each line of the file, -1 for lines that are not monitored
+	vector<int> _lineDisk;
+	bool _remap = true;
+	RateClock _clock;
+	unsigned long long _ticks = 0;
+
+	int find_disk(const char* name, size_t length);
+
+  public:
+	// Roots are only changed to point the source at a copy of the files, for benchmarks
+	DiskActivity(const string &procRoot = "/proc", const string &sysRoot = "/sys");
+	vector<MetricInfo> metrics() override;
+	int sample_cost_us() override;
+	void sample(float* values) override;
+};
+
+#endif
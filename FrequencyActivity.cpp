@@ -0,0 +1,118 @@
+#include "FrequencyActivity.h"
+
+#ifndef _WIN32
+
+#include <algorithm>
+#include <iostream>
+#include <set>
+#include <unistd.h>
+
+using namespace std;
+
+// Frequencies move with load, so they are sampled more often than most sources
+static const chrono::milliseconds samplePeriod(1000);
+
+static unsigned long long read_number(const string &path) {
+	ProcFile file(path, 64);
+	const char* pos = file.read();
+	return pos ? parse_uint(pos) : 0;
+}
+
+// cpu0, cpu1, ... exist for every possible CPU, online or not. Offline ones have no
+// cpufreq directory and are skipped. Core counters are the same on every SMT sibling of a
+// core, and package counters on every core of a package, so each is only read once.
+FrequencyActivity::FrequencyActivity(const string &sysRoot) {
+	string cpuRoot = sysRoot + "/devices/system/cpu/cpu";
+	set<unsigned long long> packages;
+	set<pair<unsigned long long, unsigned long long>> coreIds;
+	for (int cpu = 0; access((cpuRoot + to_string(cpu)).c_str(), F_OK) == 0; ++cpu) {
+		string dir = cpuRoot + to_string(cpu);
+		unsigned long long maxKHz = read_number(dir + "/cpufreq/cpuinfo_max_freq");
+		ProcFile curFreq(dir + "/cpufreq/scaling_cur_freq", 64);
+		if (maxKHz > 0 && curFreq.is_open()) {
+			_cores.push_back(Core{ move(curFreq), static_cast<float>(maxKHz) });
+		}
+
+		unsigned long long package = read_number(dir + "/topology/physical_package_id");
+		if (coreIds.insert({ package, read_number(dir + "/topology/core_id") }).second) {
+			ProcFile coreThrottles(dir + "/thermal_throttle/core_throttle_count", 64);
+			if (coreThrottles.is_open()) {
+				_throttles.push_back(Throttle{ move(coreThrottles), 0 });
+			}
+		}
+		if (packages.insert(package).second) {
+			ProcFile packageThrottles(dir + "/thermal_throttle/package_throttle_count", 64);
+			if (packageThrottles.is_open()) {
+				_throttles.push_back(Throttle{ move(packageThrottles), 0 });
+			}
+		}
+	}
+	if (_cores.empty()) {
+		cout << "No cpufreq in " << sysRoot << ", not showing CPU frequencies" << endl;
+	}
+}
+
+vector<MetricInfo> FrequencyActivity::metrics() {
+	vector<MetricInfo> infos;
+	if (!_cores.empty()) {
+		infos.push_back({"cpu.freq.avg", "%", 0});
+		infos.push_back({"cpu.freq.min", "%", 0});
+		infos.push_back({"cpu.freq.mhz", " MHz", 0});
+	}
+	if (!_throttles.empty()) {
+		infos.push_back({"cpu.throttle", "/s", 1});
+	}
+	return infos;
+}
+
+chrono::milliseconds FrequencyActivity::sample_period() {
+	return _throttling ? flashHalfPeriod : samplePeriod;
+}
+
+// A pread per core, and with intel_pstate each one has the core work out its frequency
+int FrequencyActivity::sample_cost_us() {
+	return 2 * static_cast<int>(_cores.size() + _throttles.size());
+}
+
+void FrequencyActivity::sample(float* values) {
+	if (!_cores.empty()) {
+		float sum = 0, sumKHz = 0, slowest = 100;
+		int read = 0;
+		for (auto &core : _cores) {
+			const char* pos = core.curFreq.read();
+			if (!pos) {
+				continue;
+			}
+			float kHz = static_cast<float>(parse_uint(pos));
+			float share = min(100.0f, 100 * kHz / core.maxKHz);
+			sum += share;
+			sumKHz += kHz;
+			slowest = min(slowest, share);
+			++read;
+		}
+		if (read > 0) {
+			values[0] = sum / read;
+			values[1] = slowest;
+			values[2] = sumKHz / read / 1000;
+		}
+		values += 3;
+	}
+
+	if (!_throttles.empty()) {
+		_clock.advance(chrono::steady_clock::now());
+		double events = 0;
+		for (auto &throttle : _throttles) {
+			const char* pos = throttle.count.read();
+			if (!pos) {
+				continue;
+			}
+			unsigned long long count = parse_uint(pos);
+			events += _clock.rate(count, throttle.previous);
+			throttle.previous = count;
+		}
+		values[0] = static_cast<float>(events);
+		_throttling = events > 0;
+	}
+}
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef __FrequencyActivity_h__
+#define __FrequencyActivity_h__
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "MetricSource.h"
+#include "ProcFile.h"
+#include "Rate.h"
+
+using namespace std;
+
+// Core clock speeds and thermal throttling, from sysfs (Linux only). Publishes the
+// average and slowest core's scaling_cur_freq as % of its cpuinfo_max_freq (cpu.freq.avg,
+// cpu.freq.min) and the average in MHz (cpu.freq.mhz). Where the CPU reports throttling
+// (thermal_throttle, Intel only) cpu.throttle is the throttle events per second, across
+// the core and package counters.
+//
+// While throttling it samples every flash half period, so the layout can flash on it.
+class FrequencyActivity : public MetricSource {
+	struct Core {
+		ProcFile curFreq;
+		float maxKHz;
+	};
+	struct Throttle {
+		ProcFile count;
+		unsigned long long previous;
+	};
+	// Files are found once and stay open, each sample is a pread per file
+	vector<Core> _cores;
+	vector<Throttle> _throttles;
+	RateClock _clock;
+	bool _throttling = false;
+
+  public:
+	// The root is only changed to point the source at a copy of the files, for benchmarks
+	FrequencyActivity(const string &sysRoot = "/sys");
+	vector<MetricInfo> metrics() override;
+	chrono::milliseconds sample_period() override;
+	int sample_cost_us() override;
+	void sample(float* values) override;
+};
+
+#endif
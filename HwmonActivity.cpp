@@ -0,0 +1,191 @@
+#include "HwmonActivity.h"
+
+#ifndef _WIN32
+
+#include <algorithm>
+#include <cctype>
+#include <dirent.h>
+#include <iostream>
+#include <map>
+#include <stdlib.h>
+
+using namespace std;
+
+// Lower case, with anything but letters and digits turned into '_', so sensor labels
+// such as "Package id 0" make usable metric names
+static string metric_part(const string &text) {
+	string part;
+	for (char c : text) {
+		if (c == '\n') {
+			break;
+		}
+		part += isalnum(static_cast<unsigned char>(c)) ? tolower(static_cast<unsigned char>(c)) : '_';
+	}
+	return part;
+}
+
+// First line of a small sysfs file, empty if it can not be read
+static string read_line(const string &path) {
+	ProcFile file(path, 128);
+	const char* pos = file.read();
+	if (!pos) {
+		return "";
+	}
+	return string(pos, next_line(pos) - pos);
+}
+
+static vector<string> list_dir(const string &path) {
+	vector<string> names;
+	DIR* dir = opendir(path.c_str());
+	if (!dir) {
+		return names;
+	}
+	while (dirent* entry = readdir(dir)) {
+		names.push_back(entry->d_name);
+	}
+	closedir(dir);
+	return names;
+}
+
+// Number after prefix in names such as hwmon3 or temp12_input, or -1 if name is not
+// prefix, digits and then suffix
+static int numbered(const string &name, const string &prefix, const string &suffix) {
+	if (name.size() <= prefix.size() + suffix.size() || name.compare(0, prefix.size(), prefix) != 0
+	    || name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+		return -1;
+	}
+	string digits = name.substr(prefix.size(), name.size() - prefix.size() - suffix.size());
+	if (digits.find_first_not_of("0123456789") != string::npos) {
+		return -1;
+	}
+	return atoi(digits.c_str());
+}
+
+HwmonActivity::HwmonActivity(const string &sysRoot) {
+	string hwmonRoot = sysRoot + "/class/hwmon";
+	vector<int> hwmons;
+	for (const auto &name : list_dir(hwmonRoot)) {
+		int number = numbered(name, "hwmon", "");
+		if (number >= 0) {
+			hwmons.push_back(number);
+		}
+	}
+	if (hwmons.empty()) {
+		cout << "No hwmon sensors in " << hwmonRoot << ", not showing temperatures" << endl;
+		return;
+	}
+	sort(hwmons.begin(), hwmons.end());
+
+	// Two chips of the same driver, such as a pair of NVMe drives, are told apart by a number
+	map<string, int> chipCount;
+	for (int number : hwmons) {
+		string dir = hwmonRoot + "/hwmon" + to_string(number);
+		string chip = read_line(dir + "/name");
+		// Older drivers keep their attributes on the parent device
+		if (chip.empty()) {
+			dir += "/device";
+			chip = read_line(dir + "/name");
+		}
+		if (chip.empty()) {
+			continue;
+		}
+		chip = metric_part(chip);
+		int count = ++chipCount[chip];
+		add_chip(dir, count > 1 ? chip + to_string(count) : chip);
+	}
+}
+
+vector<MetricInfo> HwmonActivity::metrics() {
+	vector<MetricInfo> infos;
+	if (_cpuSensor >= 0) {
+		infos.push_back({"temp.cpu", " C", 1});
+	}
+	if (_coolantSensor >= 0) {
+		infos.push_back({"temp.coolant", " C", 1});
+	}
+	for (const auto &sensor : _sensors) {
+		bool temperature = sensor.metric.compare(0, 5, "temp.") == 0;
+		infos.push_back({sensor.metric, temperature ? " C" : " rpm", temperature ? 1 : 0});
+	}
+	return infos;
+}
+
+// A pread per sensor, more if the driver goes out to the bus rather than caching
+int HwmonActivity::sample_cost_us() {
+	return 5 + 2 * static_cast<int>(_sensors.size());
+}
+
+void HwmonActivity::sample(float* values) {
+	float* aliases = values;
+	values += (_cpuSensor >= 0) + (_coolantSensor >= 0);
+	for (size_t index = 0; index < _sensors.size(); ++index) {
+		const char* pos = _sensors[index].input.read();
+		// Drivers fail the read while a sensor is disconnected, the last value stays
+		if (!pos) {
+			continue;
+		}
+		bool negative = *pos == '-';
+		if (negative) {
+			++pos;
+		}
+		float value = parse_uint(pos) * _sensors[index].scale;
+		values[index] = negative ? -value : value;
+	}
+	if (_cpuSensor >= 0) {
+		*aliases++ = values[_cpuSensor];
+	}
+	if (_coolantSensor >= 0) {
+		*aliases++ = values[_coolantSensor];
+	}
+}
+
+//
+// Private methods
+//
+
+void HwmonActivity::add_chip(const string &dir, const string &chip) {
+	vector<pair<string, int>> inputs;
+	for (const auto &name : list_dir(dir)) {
+		for (const char* kind : { "temp", "fan" }) {
+			int number = numbered(name, kind, "_input");
+			if (number >= 0) {
+				inputs.push_back({kind, number});
+			}
+		}
+	}
+	sort(inputs.begin(), inputs.end());
+
+	bool cpuChip = chip == "coretemp" || chip == "k10temp" || chip == "zenpower" || chip == "cpu_thermal";
+	bool packageFound = false;
+	int firstIndex = static_cast<int>(_sensors.size());
+	for (const auto &input : inputs) {
+		string attribute = input.first + to_string(input.second);
+		ProcFile file(dir + "/" + attribute + "_input", 32);
+		if (!file.is_open()) {
+			continue;
+		}
+		string label = metric_part(read_line(dir + "/" + attribute + "_label"));
+		if (label.empty()) {
+			label = attribute;
+		}
+		bool temperature = input.first == "temp";
+		int index = static_cast<int>(_sensors.size());
+		_sensors.push_back(Sensor{input.first + "." + chip + "." + label, move(file), temperature ? 0.001f : 1.0f});
+		if (!temperature) {
+			continue;
+		}
+		// The package sensor if the CPU driver has one, its first sensor otherwise. On
+		// machines with several sockets the first socket's chip is used.
+		bool package = label == "package_id_0" || label == "tctl";
+		if (cpuChip && (_cpuSensor < 0 || (package && !packageFound && _cpuSensor >= firstIndex))) {
+			_cpuSensor = index;
+			packageFound = package;
+		}
+		if (_coolantSensor < 0 && (label.find("coolant") != string::npos || label.find("liquid") != string::npos
+		                           || label.find("water") != string::npos)) {
+			_coolantSensor = index;
+		}
+	}
+}
+
+#endif
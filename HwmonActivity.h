@@ -0,0 +1,39 @@
+#ifndef __HwmonActivity_h__
+#define __HwmonActivity_h__
+
+#include <string>
+#include <vector>
+
+#include "MetricSource.h"
+#include "ProcFile.h"
+
+using namespace std;
+
+// Temperatures and fan speeds from the hwmon drivers in /sys/class/hwmon (Linux only).
+// Every sensor is published as temp.<chip>.<label> in degrees C or fan.<chip>.<label>
+// in rpm. temp.cpu and temp.coolant pick out the sensors the layout cares about, and
+// are only published if the machine has such a sensor.
+class HwmonActivity : public MetricSource {
+	struct Sensor {
+		string metric;
+		ProcFile input;
+		// Reported value per unit of the file, millidegrees for temperatures
+		float scale;
+	};
+	// Sensors are found once, their files stay open and are only re-read
+	vector<Sensor> _sensors;
+	// Sensors behind temp.cpu and temp.coolant, -1 if there is none
+	int _cpuSensor = -1;
+	int _coolantSensor = -1;
+
+	void add_chip(const string &dir, const string &chip);
+
+  public:
+	// The root is only changed to point the source at a copy of the files, for benchmarks
+	HwmonActivity(const string &sysRoot = "/sys");
+	vector<MetricInfo> metrics() override;
+	int sample_cost_us() override;
+	void sample(float* values) override;
+};
+
+#endif
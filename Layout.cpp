@@ -0,0 +1,298 @@
+#include <algorithm>
+#include <iostream>
+#include <string.h>
+
+#include "Layout.h"
+#include "Trace.h"
+
+using namespace std;
+
+// The layers of each stacked bar. Idle CPU time and free RAM are left to the segment's
+// off color. I/O wait is idle time, as cpu.load counts it, so it is left out of the CPU
+// stack too and the stack is as tall as the load.
+static const StackLayer cpuStack[] = {
+	{ "cpu.user",    &Theme::cpu_active },
+	{ "cpu.nice",    &Theme::cpu_active },
+	{ "cpu.system",  &Theme::cpu_system },
+	{ "cpu.irq",     &Theme::cpu_irq },
+	{ "cpu.softirq", &Theme::cpu_irq },
+	{ "cpu.steal",   &Theme::cpu_steal },
+};
+static const StackLayer memoryStack[] = {
+	{ "memory.used",  &Theme::ram_active },
+	{ "memory.cache", &Theme::ram_cache },
+};
+
+static const struct {
+	const char* name;
+	const StackLayer* layers;
+	int count;
+} stacks[] = {
+	{ "cpu.breakdown",    cpuStack,    sizeof(cpuStack) / sizeof(cpuStack[0]) },
+	{ "memory.breakdown", memoryStack, sizeof(memoryStack) / sizeof(memoryStack[0]) },
+};
+
+// Styles drawn over a segment's other row rather than instead of it
+static bool overlay(RenderStyle style) {
+	return style == RS_Alert || style == RS_Flash;
+}
+
+// A segment is shown by the first row that binds any of its LEDs
+static bool overlaps(const LedStrip &a, const LedStrip &b) {
+	for (const auto &led : a) {
+		for (const auto &other : b) {
+			if (led.device == other.device && led.index == other.index) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+// Which metric drives which segment. Sources are bound by metric name, so adding a
+// source only needs a line here to show it.
+static const SegmentBinding layout[] = {
+	// Where the CPU time goes if the breakdown is published, or else just the load
+	{ "cpu",       0, CDT_CommanderPro, 0,          RS_Stacked,  "cpu.breakdown",       0, 100, &Theme::cpu_active, &Theme::cpu_base },
+	{ "cpu",       0, CDT_CommanderPro, 0,          RS_Activity, "cpu.load",            0, 100, &Theme::cpu_active, &Theme::cpu_base },
+	{ "gpu",       0, CDT_CommanderPro, 0,          RS_Activity, "gpu.load",            0, 100, &Theme::gpu_active, &Theme::gpu_base },
+
+	// On NUMA machines each RAM stick shows the memory used on its node, as memory.module.<n>.
+	// Otherwise the sticks are one bar from the first to the last: used and cached RAM if
+	// the breakdown is published, or else memory in use including swap.
+	{ "ram",       0, CDT_MemoryModule, eachDevice, RS_Activity, "memory.module",       0, 100, &Theme::ram_active, &Theme::ram_base },
+	{ "ram",       0, CDT_MemoryModule, allDevices, RS_Stacked,  "memory.breakdown",    0, 100, &Theme::ram_active, &Theme::ram_base },
+	{ "ram",       0, CDT_MemoryModule, allDevices, RS_Activity, "memory.usage",        0, 100, &Theme::ram_active, &Theme::ram_base },
+
+	// Show time on fans, hour (top), first digit of minute, second digit (bottom)
+	{ "fan",       0, CDT_CommanderPro, 0,          RS_Binary,   "clock.hour12",        0,   0, &Theme::fans_one,   &Theme::fans_zero },
+	{ "fan",       1, CDT_CommanderPro, 0,          RS_Binary,   "clock.minute_tens",   0,   0, &Theme::fans_one,   &Theme::fans_zero },
+	{ "fan",       2, CDT_CommanderPro, 0,          RS_Binary,   "clock.minute_ones",   0,   0, &Theme::fans_one,   &Theme::fans_zero },
+
+	// Coolant temperature if there is a probe, the CPU's if not, or just the pump color
+	{ "reservoir", 0, CDT_CommanderPro, 0,          RS_Activity, "temp.coolant",       25,  45, &Theme::pump_hot,   &Theme::pump },
+	{ "reservoir", 0, CDT_CommanderPro, 0,          RS_Activity, "temp.cpu",           35,  90, &Theme::pump_hot,   &Theme::pump },
+	{ "reservoir", 0, CDT_CommanderPro, 0,          RS_Static,   nullptr,               0,   0, &Theme::pump,       &Theme::pump },
+
+	// Tasks stalled waiting on CPU or memory, shown as soon as a PSI trigger fires
+	{ "cpu",       0, CDT_CommanderPro, 0,          RS_Alert,    "psi.cpu.some",       25,   0, &Theme::alert,      &Theme::alert },
+	{ "ram",       0, CDT_MemoryModule, allDevices, RS_Alert,    "psi.memory.some",    10,   0, &Theme::alert,      &Theme::alert },
+
+	// The CPU is being held back to keep it cool
+	{ "cpu",       0, CDT_CommanderPro, 0,          RS_Flash,    "cpu.throttle",      0.1,   0, &Theme::throttle,   &Theme::throttle },
+
+	// Pages are being swapped back in, so something is waiting on memory that had run out
+	{ "ram",       0, CDT_MemoryModule, allDevices, RS_Flash,    "vm.pswpin",           1,   0, &Theme::alert,      &Theme::alert },
+};
+
+Layout::Layout(RgbLighting* lighting, const DeviceRegistry &devices, const MetricRegistry &registry,
+               const Theme &theme) : _lighting(lighting), _theme(theme), _byType(devices.byType) {
+	for (int row = 0; row < static_cast<int>(sizeof(layout) / sizeof(layout[0])); ++row) {
+		resolve_row(row, registry, _bindings);
+	}
+}
+
+// Rows on a changed slot, or on a device type whose devices moved, are bound again in
+// table order around the rows that are kept, so fallback and drawing order still hold
+void Layout::update_devices(const MetricRegistry &registry, const DeviceRegistry &devices,
+                            const vector<int> &changed) {
+	int rows = static_cast<int>(sizeof(layout) / sizeof(layout[0]));
+	vector<char> rebind(rows);
+	for (int row = 0; row < rows; ++row) {
+		rebind[row] = _byType[layout[row].device] != devices.byType[layout[row].device];
+	}
+	for (const auto &binding : _bindings) {
+		for (const auto &led : binding.strip) {
+			if (find(changed.begin(), changed.end(), led.device) != changed.end()) {
+				rebind[binding.row] = 1;
+				break;
+			}
+		}
+	}
+	_byType = devices.byType;
+
+	vector<ResolvedBinding> bindings;
+	size_t kept = 0;
+	for (int row = 0; row < rows; ++row) {
+		for (; kept < _bindings.size() && _bindings[kept].row <= row; ++kept) {
+			if (!rebind[_bindings[kept].row]) {
+				bindings.push_back(move(_bindings[kept]));
+			}
+		}
+		if (rebind[row]) {
+			resolve_row(row, registry, bindings);
+		}
+	}
+	_bindings.swap(bindings);
+	cout << "Devices changed, " << _bindings.size() << " segments bound" << endl;
+}
+
+void Layout::set_range(const MetricRegistry &registry, const string &metric, float rangeMin, float rangeMax) {
+	if (!(rangeMax > rangeMin)) {
+		cout << "Ignoring range of " << metric << ", " << rangeMax << " is not above " << rangeMin << endl;
+		return;
+	}
+	MetricId id = registry.find(metric);
+	if (id >= 0) {
+		_ranges.push_back(RangeOverride{ id, rangeMin, rangeMax });
+	}
+	for (auto &binding : _bindings) {
+		if (id >= 0 && binding.metric == id) {
+			binding.rangeMin = rangeMin;
+			binding.rangeMax = rangeMax;
+		}
+	}
+}
+
+void Layout::render(const MetricRegistry &registry, LedMap &ledMap) {
+	TRACE_SCOPE("render");
+	_lighting->get_led_arrays(ledMap);
+	auto sinceEpoch = chrono::steady_clock::now().time_since_epoch();
+	bool flashOn = chrono::duration_cast<chrono::milliseconds>(sinceEpoch) / flashHalfPeriod % 2 == 0;
+	for (const auto &b : _bindings) {
+		float value = registry.value(b.metric);
+		switch (b.style) {
+		case RS_Activity: {
+			// Values outside the range show as an empty or full bar
+			int percent = b.rangeMax > b.rangeMin ? static_cast<int>((value - b.rangeMin) * 100 / (b.rangeMax - b.rangeMin)) : 0;
+			_lighting->load_device_colors_activity(b.strip, min(max(percent, 0), 100), ledMap, b.off, b.on);
+			break;
+		}
+		case RS_Binary:
+			_lighting->load_device_colors_binary(b.strip, static_cast<unsigned int>(value), ledMap, b.on, b.off);
+			break;
+		case RS_Static:
+			_lighting->load_device_colors_static(b.strip, ledMap, b.on);
+			break;
+		case RS_Stacked: {
+			float top = 0;
+			for (size_t layer = 0; layer < b.layers.size(); ++layer) {
+				top += registry.value(b.layers[layer]);
+				_tops[layer] = top;
+			}
+			_lighting->load_device_colors_stacked(b.strip, _tops.data(), b.layerColors.data(),
+				static_cast<int>(b.layers.size()), b.rangeMin, b.rangeMax, ledMap, b.off);
+			break;
+		}
+		case RS_Flash:
+			if (value >= b.rangeMin && flashOn) {
+				_lighting->load_device_colors_static(b.strip, ledMap, b.on);
+			}
+			break;
+		case RS_Alert:
+			if (value >= b.rangeMin) {
+				_lighting->load_device_colors_static(b.strip, ledMap, b.on);
+			}
+			break;
+		}
+	}
+}
+
+vector<MetricId> Layout::bound_metrics() const {
+	vector<MetricId> metrics;
+	for (const auto &binding : _bindings) {
+		if (binding.metric >= 0) {
+			metrics.push_back(binding.metric);
+		}
+		metrics.insert(metrics.end(), binding.layers.begin(), binding.layers.end());
+	}
+	sort(metrics.begin(), metrics.end());
+	metrics.erase(unique(metrics.begin(), metrics.end()), metrics.end());
+	return metrics;
+}
+
+//
+// Private methods
+//
+
+void Layout::resolve_row(int row, const MetricRegistry &registry, vector<ResolvedBinding> &bindings) {
+	const SegmentBinding &binding = layout[row];
+	const vector<int> &devices = _byType[binding.device];
+	if (devices.empty()) {
+		cout << "No " << device_type_name(binding.device) << " found, not showing " << binding.segment << endl;
+		return;
+	}
+	if (binding.deviceOffset == eachDevice) {
+		// Every device or none, so the segment falls back to its next row when any device
+		// has no metric of its own
+		vector<string> names;
+		for (size_t device = 0; device < devices.size(); ++device) {
+			names.push_back(string(binding.metric) + "." + to_string(device));
+			if (registry.find(names.back()) < 0) {
+				cout << "No metric " << names.back() << " for " << binding.segment << endl;
+				return;
+			}
+		}
+		for (size_t device = 0; device < devices.size(); ++device) {
+			resolve_strip(row, names[device].c_str(), { devices[device] }, registry, bindings);
+		}
+		return;
+	}
+	if (binding.deviceOffset >= static_cast<int>(devices.size())) {
+		return;
+	}
+	resolve_strip(row, binding.metric, binding.deviceOffset == allDevices
+	              ? devices : vector<int>{ devices[binding.deviceOffset] }, registry, bindings);
+}
+
+// Binds the row's segment on devices to metricName, unless another row already shows it
+void Layout::resolve_strip(int row, const char* metricName, const vector<int> &devices,
+                           const MetricRegistry &registry, vector<ResolvedBinding> &bindings) {
+	const SegmentBinding &binding = layout[row];
+	LedStrip strip = _lighting->make_strip(binding.segment, binding.segmentIndex, devices);
+	bool bound = strip.empty();
+	for (const auto &resolved : bindings) {
+		bound |= !overlay(binding.style) && !overlay(resolved.style) && overlaps(resolved.strip, strip);
+	}
+	if (bound) {
+		return;
+	}
+	MetricId metric = -1;
+	vector<MetricId> layers;
+	vector<Color> layerColors;
+	if (binding.style == RS_Stacked) {
+		if (!resolve_stack(registry, binding.metric, layers, layerColors)) {
+			return;
+		}
+		_tops.resize(max(_tops.size(), layers.size()));
+	}
+	else if (metricName) {
+		metric = registry.find(metricName);
+		if (metric < 0) {
+			cout << "No metric " << metricName << " for " << binding.segment << endl;
+			return;
+		}
+	}
+	float rangeMin = binding.rangeMin, rangeMax = binding.rangeMax;
+	for (const auto &range : _ranges) {
+		if (range.metric == metric) {
+			rangeMin = range.rangeMin;
+			rangeMax = range.rangeMax;
+		}
+	}
+	bindings.push_back(ResolvedBinding{ row, strip, binding.style, metric, rangeMin, rangeMax,
+	                                    _theme.*binding.on, _theme.*binding.off, layers, layerColors });
+}
+
+// Every layer's metric has to exist for the stack to be drawn, or the segment falls back
+// to its next row
+bool Layout::resolve_stack(const MetricRegistry &registry, const char* name, vector<MetricId> &layers,
+                           vector<Color> &layerColors) {
+	for (const auto &stack : stacks) {
+		if (strcmp(stack.name, name) != 0) {
+			continue;
+		}
+		for (int layer = 0; layer < stack.count; ++layer) {
+			MetricId metric = registry.find(stack.layers[layer].metric);
+			if (metric < 0) {
+				cout << "No metric " << stack.layers[layer].metric << " for " << name << endl;
+				return false;
+			}
+			layers.push_back(metric);
+			layerColors.push_back(_theme.*stack.layers[layer].color);
+		}
+		return true;
+	}
+	cout << "No stack " << name << endl;
+	return false;
+}
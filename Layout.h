@@ -0,0 +1,108 @@
+#ifndef __Layout_h__
+#define __Layout_h__
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "MetricRegistry.h"
+#include "RgbLighting.h"
+
+using namespace std;
+
+struct Theme {
+	Color cpu_base, cpu_active;
+	Color cpu_system, cpu_irq, cpu_iowait, cpu_steal;
+	Color gpu_base, gpu_active;
+	Color ram_base, ram_active, ram_cache;
+	Color pump, pump_hot;
+	Color fans_one, fans_zero;
+	Color alert, throttle;
+};
+
+enum RenderStyle {
+	RS_Activity,    // bar filled to the metric's share of [rangeMin, rangeMax]
+	RS_Binary,      // metric value in binary
+	RS_Static,      // solid color, no metric
+	RS_Alert,       // solid color over whatever the segment shows, while the metric is at least rangeMin
+	RS_Flash,       // RS_Alert on every other flashHalfPeriod
+	RS_Stacked      // bar of several colored layers end to end, metric naming a stack in Layout.cpp
+};
+
+// One layer of a stacked bar, in the order they are drawn from the start of the segment
+struct StackLayer {
+	const char* metric;
+	Color Theme::*color;
+};
+
+// deviceOffset of a segment drawn as one bar across all the devices of its type, in order
+const int allDevices = -1;
+// deviceOffset of a row bound on every device of its type, the n'th device to the metric
+// named <metric>.<n>
+const int eachDevice = -2;
+
+// Binds one devInfo segment on one iCUE device to a metric. If the metric does not
+// exist on this machine, a later row for the same segment is used instead. Alert and
+// flash rows are drawn on top of the segment's other row, so they come after it.
+struct SegmentBinding {
+	const char* segment;       // devInfo name and index
+	int segmentIndex;
+	CorsairDeviceType device;  // the deviceOffset'th device of the type in the DeviceRegistry,
+	int deviceOffset;          // or allDevices for one strip across every device of the type,
+	                           // or eachDevice for a strip on each with a metric of its own
+	RenderStyle style;
+	const char* metric;
+	float rangeMin, rangeMax;
+	Color Theme::*on;          // active or one color, and base or zero color
+	Color Theme::*off;
+};
+
+// Renders registry metrics onto LEDs, as described by the binding table in Layout.cpp.
+// Names are resolved to IDs and device indices once, so a frame is only array lookups.
+class Layout {
+	struct ResolvedBinding {
+		int row;                   // in the table in Layout.cpp
+		LedStrip strip;
+		RenderStyle style;
+		MetricId metric;
+		float rangeMin, rangeMax;
+		Color on, off;
+		// The metric and color of each layer, for RS_Stacked
+		vector<MetricId> layers;
+		vector<Color> layerColors;
+	};
+	// Ranges given with set_range(), kept for bindings made again after a device change
+	struct RangeOverride {
+		MetricId metric;
+		float rangeMin, rangeMax;
+	};
+	RgbLighting* _lighting;
+	Theme _theme;
+	// The devices of each type the bindings were made for
+	array<vector<int>, deviceTypeCount> _byType;
+	// In table order, so fallback rows and overlays keep their order after a device change
+	vector<ResolvedBinding> _bindings;
+	vector<RangeOverride> _ranges;
+	// Running totals of the layers of the stack being drawn, sized for the largest stack
+	vector<float> _tops;
+
+	void resolve_row(int row, const MetricRegistry &registry, vector<ResolvedBinding> &bindings);
+	void resolve_strip(int row, const char* metricName, const vector<int> &devices, const MetricRegistry &registry,
+	                   vector<ResolvedBinding> &bindings);
+	bool resolve_stack(const MetricRegistry &registry, const char* name, vector<MetricId> &layers,
+	                   vector<Color> &layerColors);
+
+  public:
+	Layout(RgbLighting* lighting, const DeviceRegistry &devices, const MetricRegistry &registry, const Theme &theme);
+	// Binds the rows on devices that changed again, after RgbLighting::check_devices()
+	// found some. Segments on the other devices keep their bindings and go on drawing.
+	void update_devices(const MetricRegistry &registry, const DeviceRegistry &devices, const vector<int> &changed);
+	// Changes the [rangeMin, rangeMax] of every segment showing metric. A range whose max
+	// is not above its min is ignored.
+	void set_range(const MetricRegistry &registry, const string &metric, float rangeMin, float rangeMax);
+	void render(const MetricRegistry &registry, LedMap &ledMap);
+	// Metrics the bound segments show, stack layers included, in ID order
+	vector<MetricId> bound_metrics() const;
+};
+
+#endif
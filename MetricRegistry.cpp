@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <errno.h>
+#include <iomanip>
+#include <iostream>
+#include <string.h>
+#include <thread>
+
+#include "MetricRegistry.h"
+
+using namespace std;
+
+MetricRegistry::~MetricRegistry() {
+	for (auto &entry : _entries) {
+		delete entry.source;
+	}
+}
+
+// IDs are handed out in registration order, so they are stable for a given set of sources
+void MetricRegistry::add(MetricSource* source) {
+	auto infos = source->metrics();
+	Entry entry{ source, static_cast<MetricId>(_metrics.size()), static_cast<int>(infos.size()),
+	             source->sample_period(), source->sample_cost_us(), chrono::steady_clock::time_point() };
+	_metrics.insert(_metrics.end(), infos.begin(), infos.end());
+	_snapshot.resize(_metrics.size(), 0);
+
+	auto pos = find_if(_entries.begin(), _entries.end(), [&](const Entry &e) { return e.cost > entry.cost; });
+	_entries.insert(pos, entry);
+#ifndef _WIN32
+	for (int fd : source->wake_fds()) {
+		_wakeFds.push_back(pollfd{ fd, POLLPRI, 0 });
+		_wakeSources.push_back(source);
+	}
+#endif
+
+	// Sources with nothing to measure on this machine, such as hwmon without sensors, say so themselves
+	if (infos.empty()) {
+		return;
+	}
+	cout << "Registered";
+	for (auto &info : infos) {
+		cout << " " << info.name;
+	}
+	cout << ", every " << entry.period.count() << " ms at ~" << entry.cost << " us" << endl;
+}
+
+MetricId MetricRegistry::find(const string &name) const {
+	for (size_t id = 0; id < _metrics.size(); ++id) {
+		if (_metrics[id].name == name) {
+			return static_cast<MetricId>(id);
+		}
+	}
+	return -1;
+}
+
+int MetricRegistry::metric_count() const {
+	return static_cast<int>(_metrics.size());
+}
+
+const MetricInfo& MetricRegistry::info(MetricId id) const {
+	return _metrics[id];
+}
+
+float MetricRegistry::value(MetricId id) const {
+	return (id >= 0) ? _snapshot[id] : 0;
+}
+
+void MetricRegistry::set_value(MetricId id, float value) {
+	if (id >= 0) {
+		_snapshot[id] = value;
+	}
+}
+
+const float* MetricRegistry::snapshot() const {
+	return _snapshot.data();
+}
+
+void MetricRegistry::print_status(ostream &out) const {
+	for (auto &entry : _entries) {
+		entry.source->print_status(out);
+	}
+}
+
+void MetricRegistry::print_status_line(ostream &out, const vector<MetricId> &metrics, time_t now) const {
+	tm local;
+#ifdef _WIN32
+	localtime_s(&local, &now);
+#else
+	// As in ClockActivity, localtime() would allocate on every call
+	localtime_r(&now, &local);
+#endif
+	out << "Time: " << setw(2) << setfill('0') << local.tm_hour
+	    << ":" << setw(2) << setfill('0') << local.tm_min
+	    << ":" << setw(2) << setfill('0') << local.tm_sec;
+	for (MetricId id : metrics) {
+		const MetricInfo &info = _metrics[id];
+		out << ", " << info.name << ": " << fixed << setprecision(info.precision) << _snapshot[id] << info.unit;
+	}
+	print_status(out);
+}
+
+bool MetricRegistry::sample_due(chrono::steady_clock::time_point now) {
+	bool running = true;
+	_sampled = false;
+	for (auto &entry : _entries) {
+		if (entry.nextSample <= now) {
+			_sampled = true;
+			entry.source->sample(&_snapshot[entry.firstId]);
+			entry.period = entry.source->sample_period();
+			// Scheduled from the previous due time so the period does not drift, unless we fell
+			// behind or the source gave the time from now
+			entry.nextSample = entry.source->period_from_now() ? now + entry.period : entry.nextSample + entry.period;
+			if (entry.nextSample <= now) {
+				entry.nextSample = now + entry.period;
+			}
+		}
+		running = running && !entry.source->finished();
+	}
+	return running;
+}
+
+bool MetricRegistry::sampled() const {
+	return _sampled;
+}
+
+chrono::steady_clock::time_point MetricRegistry::next_due() const {
+	auto due = chrono::steady_clock::time_point::max();
+	for (auto &entry : _entries) {
+		due = min(due, entry.nextSample);
+	}
+	return due;
+}
+
+bool MetricRegistry::wait_and_sample(chrono::steady_clock::time_point latest) {
+	auto due = min(next_due(), latest);
+#ifdef _WIN32
+	this_thread::sleep_until(due);
+#else
+	while (!poll_until(due)) {
+	}
+#endif
+	return sample_due(chrono::steady_clock::now());
+}
+
+//
+// Private methods
+//
+
+#ifndef _WIN32
+// Waits for due or a wake fd, whichever is first, and makes the sources of any fds that
+// polled ready due now. False if woken early with nothing to sample, by a signal. If
+// poll() fails any other way, which would fail again at once, it sleeps until due instead.
+bool MetricRegistry::poll_until(chrono::steady_clock::time_point due) {
+	auto now = chrono::steady_clock::now();
+	if (due <= now) {
+		return true;
+	}
+	int timeoutMs = -1;
+	if (due != chrono::steady_clock::time_point::max()) {
+		timeoutMs = static_cast<int>(chrono::ceil<chrono::milliseconds>(due - now).count());
+	}
+	int ready = poll(_wakeFds.data(), _wakeFds.size(), timeoutMs);
+	if (ready < 0 && errno != EINTR) {
+		if (!_pollFailed) {
+			cout << "Waiting for PSI triggers failed (" << strerror(errno) << "), sampling on time only" << endl;
+			_pollFailed = true;
+		}
+		this_thread::sleep_until(due);
+		return true;
+	}
+	if (ready <= 0) {
+		return ready == 0;
+	}
+	now = chrono::steady_clock::now();
+	for (size_t i = 0; i < _wakeFds.size(); ++i) {
+		auto &wakeFd = _wakeFds[i];
+		if (!wakeFd.revents) {
+			continue;
+		}
+		// The fd can no longer wake us, poll() skips negative fds
+		if (wakeFd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+			wakeFd.fd = -1;
+			continue;
+		}
+		_wakeSources[i]->wake(wakeFd.fd);
+		for (auto &entry : _entries) {
+			if (entry.source == _wakeSources[i]) {
+				entry.nextSample = now;
+			}
+		}
+	}
+	return true;
+}
+#endif
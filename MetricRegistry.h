@@ -0,0 +1,67 @@
+#ifndef __MetricRegistry_h__
+#define __MetricRegistry_h__
+
+#include <chrono>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <poll.h>
+#endif
+
+#include "MetricSource.h"
+
+using namespace std;
+
+// Owns every metric source and the flat, ID-indexed snapshot of their latest values
+class MetricRegistry {
+	struct Entry {
+		MetricSource* source;
+		MetricId firstId;
+		int count;
+		chrono::milliseconds period;
+		int cost;
+		chrono::steady_clock::time_point nextSample;
+	};
+	vector<Entry> _entries;
+	vector<MetricInfo> _metrics;
+	vector<float> _snapshot;
+	bool _sampled = false;
+#ifndef _WIN32
+	// Every source's wake_fds(), and the source each belongs to
+	vector<pollfd> _wakeFds;
+	vector<MetricSource*> _wakeSources;
+	// Whether poll() has failed, so the failure is only reported once
+	bool _pollFailed = false;
+
+	bool poll_until(chrono::steady_clock::time_point due);
+#endif
+
+  public:
+	~MetricRegistry();
+	// Takes ownership of source
+	void add(MetricSource* source);
+	MetricId find(const string &name) const;
+	int metric_count() const;
+	const MetricInfo& info(MetricId id) const;
+	float value(MetricId id) const;
+	void set_value(MetricId id, float value);
+	const float* snapshot() const;
+	// Each source's print_status(), in the order they are sampled
+	void print_status(ostream &out) const;
+	// The status line main() prints after each sample, without the newline: the local time,
+	// the value of each of metrics, then print_status()
+	void print_status_line(ostream &out, const vector<MetricId> &metrics, time_t now) const;
+
+	// Samples every source due by now, returns false once any source has finished
+	bool sample_due(chrono::steady_clock::time_point now);
+	// Whether the latest sample_due() sampled any source, rather than only passing time
+	bool sampled() const;
+	chrono::steady_clock::time_point next_due() const;
+	// Sleeps until the next source is due, or one of their wake_fds() is ready, then samples.
+	// Returns by latest even if nothing is due, so the caller can draw an animation frame.
+	bool wait_and_sample(chrono::steady_clock::time_point latest = chrono::steady_clock::time_point::max());
+};
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef __MetricSource_h__
+#define __MetricSource_h__
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Index of a metric in MetricRegistry's snapshot, -1 when there is no such metric
+using MetricId = int;
+
+// How often sources sample unless they have a reason to do otherwise
+static const chrono::milliseconds defaultSamplePeriod(5000);
+
+// Time a flashing segment spends on and then off. Sources that drive a flash sample this
+// often while it is on, so the loop renders every phase.
+static const chrono::milliseconds flashHalfPeriod(250);
+
+struct MetricInfo {
+	string name;       // dotted, source first - "cpu.load", "self.rss"
+	string unit;       // printed straight after the value - "%", " MiB"
+	int precision;     // decimals shown in the status line
+};
+
+// Anything that produces metrics. Sources are added to a MetricRegistry, which
+// assigns IDs to their metrics and samples them on their preferred period.
+class MetricSource {
+  public:
+	virtual ~MetricSource() {}
+	// Metrics this source produces, sample() writes them in the same order
+	virtual vector<MetricInfo> metrics() = 0;
+	// Asked again after every sample, so a source can speed up while something is happening
+	virtual chrono::milliseconds sample_period() { return defaultSamplePeriod; }
+	// True when sample_period() is the time from now until the source is next due, as for a
+	// source that keeps its own schedule, rather than an interval the registry keeps to
+	virtual bool period_from_now() { return false; }
+	// Rough cost of one sample() in microseconds, cheaper sources are sampled first
+	virtual int sample_cost_us() = 0;
+	// Writes the current value of each metric to values[0 .. metrics().size())
+	virtual void sample(float* values) = 0;
+	// True once the source has nothing more to report, which ends the main loop
+	virtual bool finished() { return false; }
+
+	// File descriptors that wake the registry early when they poll POLLPRI, as kernel
+	// triggers do (Linux only). wake() is told which one, then the source is sampled.
+	virtual vector<int> wake_fds() { return {}; }
+	virtual void wake(int fd) {}
+
+	// Adds anything that is not a number, such as process names, to the status line
+	virtual void print_status(ostream &out) {}
+};
+
+#endif
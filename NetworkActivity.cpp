@@ -0,0 +1,211 @@
+#include "NetworkActivity.h"
+
+#ifndef _WIN32
+
+#include <algorithm>
+#include <iostream>
+#include <string.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Header lines of /proc/net/dev before the first interface
+static const int headerLines = 2;
+
+// The counters are unsigned long in the kernel, so 32 bits wide on 32-bit kernels, where
+// they wrap rather than reset when they go backwards from below 2^32
+static const CounterWrap counterWrap = sizeof(long) == 4 ? CW_Wrap32 : CW_Reset;
+
+static bool matches(const string &name, const vector<string> &patterns) {
+	for (const auto &pattern : patterns) {
+		if (!pattern.empty() && pattern.back() == '*'
+		    ? name.compare(0, pattern.size() - 1, pattern, 0, pattern.size() - 1) == 0
+		    : name == pattern) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Lines are "  name: rx fields | tx fields", the name runs up to the colon
+static size_t name_length(const char* line) {
+	size_t length = 0;
+	while (line[length] && line[length] != ':' && line[length] != '\n') {
+		++length;
+	}
+	return length;
+}
+
+// /sys/class/net/<name>/speed is in Mb/s, virtual interfaces fail the read or give -1
+static double link_speed_bits(const string &path) {
+	ProcFile speedFile(path, 64);
+	const char* pos = speedFile.read();
+	if (!pos || *pos < '0' || *pos > '9') {
+		return 0;
+	}
+	return parse_uint(pos) * 1e6;
+}
+
+NetworkActivity::NetworkActivity(const vector<string> &include, const vector<string> &exclude,
+                                 const string &procRoot, const string &sysRoot, bool virtualTotals)
+	: _netDev(procRoot + "/net/dev", 16 * 1024) {
+	const char* pos = _netDev.read();
+	if (!pos) {
+		cout << "Opening /proc/net/dev failed, network activity will read as 0" << endl;
+		return;
+	}
+	for (int line = 0; line < headerLines && *pos; ++line) {
+		pos = next_line(pos);
+	}
+	while (*pos) {
+		const char* line = skip_spaces(pos);
+		size_t length = name_length(line);
+		string name(line, length);
+		if (length < sizeof(Interface::name) && (include.empty() || matches(name, include)) && !matches(name, exclude)) {
+			Interface interface = {};
+			memcpy(interface.name, line, length);
+			interface.speedBits = link_speed_bits(sysRoot + "/class/net/" + name + "/speed");
+			interface.inTotals = virtualTotals || access((sysRoot + "/class/net/" + name + "/device").c_str(), F_OK) == 0;
+			_interfaces.push_back(interface);
+		}
+		pos = next_line(pos);
+	}
+}
+
+vector<MetricInfo> NetworkActivity::metrics() {
+	vector<MetricInfo> infos = { {"net.rx", " MB/s", 2}, {"net.tx", " MB/s", 2}, {"net.util", "%", 0} };
+	for (const auto &interface : _interfaces) {
+		string prefix = string("net.") + interface.name;
+		infos.push_back({prefix + ".rx", " MB/s", 2});
+		infos.push_back({prefix + ".tx", " MB/s", 2});
+		infos.push_back({prefix + ".rx_packets", " pkt/s", 0});
+		infos.push_back({prefix + ".tx_packets", " pkt/s", 0});
+		infos.push_back({prefix + ".util", "%", 0});
+	}
+	return infos;
+}
+
+// One pread, and a parse of a line per interface
+int NetworkActivity::sample_cost_us() {
+	return 10;
+}
+
+void NetworkActivity::sample(float* values) {
+	const char* pos = _netDev.read();
+	if (!pos) {
+		return;
+	}
+	_clock.advance(_netDev.read_time());
+	bool rates = _clock.ready();
+	++_ticks;
+	float totalRx = 0, totalTx = 0, busiest = 0;
+
+	// Same scheme as DiskActivity: the line each interface is on is worked out once, and
+	// interfaces coming or going show up as a name mismatch or a change in the number of
+	// lines, which maps the lines again
+	bool remap = _remap;
+	_remap = false;
+	if (remap) {
+		_lineInterface.clear();
+	}
+	for (int line = 0; line < headerLines && *pos; ++line) {
+		pos = next_line(pos);
+	}
+	// Fields after the name: rx bytes, packets, errs, drop, fifo, frame, compressed,
+	// multicast, then tx bytes, packets, ...
+	size_t lineNumber = 0;
+	for (; *pos; ++lineNumber) {
+		const char* line = pos;
+		pos = next_line(pos);
+		if (!remap && (lineNumber >= _lineInterface.size() || _lineInterface[lineNumber] < 0)) {
+			continue;
+		}
+		line = skip_spaces(line);
+		size_t length = name_length(line);
+		int index;
+		if (remap) {
+			index = find_interface(line, length);
+			_lineInterface.push_back(index);
+		}
+		else {
+			index = _lineInterface[lineNumber];
+			if (strncmp(_interfaces[index].name, line, length) != 0 || _interfaces[index].name[length] != '\0') {
+				_remap = true;
+				continue;
+			}
+		}
+		if (index < 0 || line[length] != ':') {
+			continue;
+		}
+		line += length + 1;
+		unsigned long long fields[10];
+		for (auto &field : fields) {
+			field = parse_uint(line);
+		}
+
+		Interface &interface = _interfaces[index];
+		float *interfaceValues = values + 3 + 5 * index;
+		if (rates && !interface.missing) {
+			double rxBytes = _clock.rate(fields[0], interface.rxBytes, counterWrap);
+			double txBytes = _clock.rate(fields[8], interface.txBytes, counterWrap);
+			interfaceValues[0] = rxBytes / 1e6;
+			interfaceValues[1] = txBytes / 1e6;
+			interfaceValues[2] = _clock.rate(fields[1], interface.rxPackets, counterWrap);
+			interfaceValues[3] = _clock.rate(fields[9], interface.txPackets, counterWrap);
+			// Links are full duplex, so the busier direction is how full the link is
+			interfaceValues[4] = interface.speedBits > 0
+				? min(100.0, max(rxBytes, txBytes) * 8 * 100 / interface.speedBits) : 0;
+			if (interface.inTotals) {
+				totalRx += interfaceValues[0];
+				totalTx += interfaceValues[1];
+				busiest = max(busiest, interfaceValues[4]);
+			}
+		}
+		interface.rxBytes = fields[0];
+		interface.rxPackets = fields[1];
+		interface.txBytes = fields[8];
+		interface.txPackets = fields[9];
+		interface.missing = false;
+		interface.readTick = _ticks;
+	}
+	if (lineNumber != _lineInterface.size()) {
+		_remap = true;
+	}
+	// Interfaces not read on a sample that found the lines moved are an interval behind,
+	// so the sample that maps the lines again only takes their counters
+	if (_remap) {
+		for (auto &interface : _interfaces) {
+			interface.missing = interface.missing || interface.readTick != _ticks;
+		}
+	}
+
+	// Interfaces on no line have gone, and their last rates would otherwise stay up
+	if (remap) {
+		for (size_t index = 0; index < _interfaces.size(); ++index) {
+			if (find(_lineInterface.begin(), _lineInterface.end(), static_cast<int>(index)) == _lineInterface.end()) {
+				fill(values + 3 + 5 * index, values + 8 + 5 * index, 0.0f);
+				_interfaces[index].missing = true;
+			}
+		}
+	}
+
+	values[0] = totalRx;
+	values[1] = totalTx;
+	values[2] = busiest;
+}
+
+//
+// Private methods
+//
+
+int NetworkActivity::find_interface(const char* name, size_t length) {
+	for (size_t index = 0; index < _interfaces.size(); ++index) {
+		const char* interfaceName = _interfaces[index].name;
+		if (strncmp(interfaceName, name, length) == 0 && interfaceName[length] == '\0') {
+			return static_cast<int>(index);
+		}
+	}
+	return -1;
+}
+
+#endif
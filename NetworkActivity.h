@@ -0,0 +1,60 @@
+#ifndef __NetworkActivity_h__
+#define __NetworkActivity_h__
+
+#include <string>
+#include <vector>
+
+#include "MetricSource.h"
+#include "ProcFile.h"
+#include "Rate.h"
+
+using namespace std;
+
+// Throughput of the network interfaces, from /proc/net/dev (Linux only). Publishes
+// totals (net.rx, net.tx in MB/s, net.util as the busiest interface's % of its link
+// speed) and per interface net.<name>.rx, .tx, .rx_packets, .tx_packets and .util.
+//
+// Traffic of containers and VMs crosses a veth or tap, a bridge and the physical port,
+// so by default the totals only count interfaces backed by a device, those with a
+// /sys/class/net/<name>/device.
+//
+// Interfaces are found once, at start. One that goes away reads as 0 until it comes back,
+// and interfaces added later are only shown after a restart.
+class NetworkActivity : public MetricSource {
+	struct Interface {
+		char name[32];
+		// Link speed in bits per second, 0 when the driver does not report one
+		double speedBits;
+		bool inTotals;
+		unsigned long long rxBytes;
+		unsigned long long rxPackets;
+		unsigned long long txBytes;
+		unsigned long long txPackets;
+		// As for DiskActivity's disks: no counters to take a rate from, and _ticks when the
+		// counters were stored
+		bool missing;
+		unsigned long long readTick;
+	};
+	ProcFile _netDev;
+	vector<Interface> _interfaces;
+	// Interface on each line of the file, -1 for lines that are not monitored
+	vector<int> _lineInterface;
+	bool _remap = true;
+	RateClock _clock;
+	unsigned long long _ticks = 0;
+
+	int find_interface(const char* name, size_t length);
+
+  public:
+	// Interfaces are picked by name, a trailing '*' matches any suffix. An empty include
+	// list watches every interface that is not excluded. Roots are only changed to point
+	// the source at a copy of the files, for benchmarks.
+	// virtualTotals counts virtual interfaces in the totals too.
+	NetworkActivity(const vector<string> &include = {}, const vector<string> &exclude = {"lo"},
+	                const string &procRoot = "/proc", const string &sysRoot = "/sys", bool virtualTotals = false);
+	vector<MetricInfo> metrics() override;
+	int sample_cost_us() override;
+	void sample(float* values) override;
+};
+
+#endif
@@ -0,0 +1,174 @@
+#include "NumaActivity.h"
+
+#ifndef _WIN32
+
+#include <iostream>
+#include <string.h>
+
+#include "Rate.h"
+
+using namespace std;
+
+// A sysfs CPU or node list such as "0-31,64-95"
+static vector<int> parse_list(const char* pos) {
+	vector<int> items;
+	while (pos && *pos >= '0' && *pos <= '9') {
+		int first = static_cast<int>(parse_uint(pos));
+		int last = first;
+		if (*pos == '-') {
+			++pos;
+			last = static_cast<int>(parse_uint(pos));
+		}
+		for (int item = first; item <= last; ++item) {
+			items.push_back(item);
+		}
+		if (*pos == ',') {
+			++pos;
+		}
+	}
+	return items;
+}
+
+NumaActivity::NumaActivity(int moduleCount, const vector<int> &modules, const string &sysRoot,
+                           const string &procRoot)
+	: _stat(procRoot + "/stat", 64 * 1024) {
+	string nodeRoot = sysRoot + "/devices/system/node/";
+	ProcFile online(nodeRoot + "online", 256);
+	vector<int> ids = parse_list(online.read());
+	if (ids.size() < 2) {
+		return;
+	}
+	for (int id : ids) {
+		string dir = nodeRoot + "node" + to_string(id);
+		ProcFile cpuList(dir + "/cpulist", 256);
+		Node node = { id, ProcFile(dir + "/meminfo"), parse_list(cpuList.read()), 0, 0 };
+		if (node.meminfo.is_open()) {
+			_nodes.push_back(move(node));
+		}
+	}
+	if (_nodes.size() < 2) {
+		cout << "Opening NUMA node meminfo failed, RAM sticks will show the whole machine" << endl;
+		_nodes.clear();
+		return;
+	}
+
+	if (modules.empty()) {
+		for (int module = 0; module < moduleCount; ++module) {
+			_moduleNodes.push_back(static_cast<int>(module * _nodes.size() / moduleCount));
+		}
+	}
+	else if (static_cast<int>(modules.size()) != moduleCount) {
+		// No module is published, as the layout binds every stick to its node or none of them
+		cout << "NUMA nodes given for " << modules.size() << " memory modules, but " << moduleCount
+		     << " were found, RAM sticks will show the whole machine" << endl;
+	}
+	else {
+		for (int id : modules) {
+			int index = -1;
+			for (size_t node = 0; node < _nodes.size(); ++node) {
+				if (_nodes[node].id == id) {
+					index = static_cast<int>(node);
+				}
+			}
+			if (index < 0) {
+				cout << "No NUMA node " << id << ", memory module " << _moduleNodes.size() << " will read as 0" << endl;
+			}
+			_moduleNodes.push_back(index);
+		}
+	}
+
+	// One parse up front sizes the snapshot for every CPU
+	const char* stat = _stat.read();
+	if (stat) {
+		parse_proc_stat(stat, _procStat);
+	}
+}
+
+vector<MetricInfo> NumaActivity::metrics() {
+	vector<MetricInfo> infos;
+	for (const auto &node : _nodes) {
+		string prefix = "numa." + to_string(node.id);
+		infos.push_back({prefix + ".memory", "%", 0});
+		infos.push_back({prefix + ".load", "%", 0});
+	}
+	for (size_t module = 0; module < _moduleNodes.size(); ++module) {
+		infos.push_back({"memory.module." + to_string(module), "%", 0});
+	}
+	return infos;
+}
+
+// A pread of /proc/stat and of each node's meminfo
+int NumaActivity::sample_cost_us() {
+	return _nodes.empty() ? 0 : 30 + 10 * static_cast<int>(_nodes.size());
+}
+
+void NumaActivity::sample(float* values) {
+	if (_nodes.empty()) {
+		return;
+	}
+	const char* stat = _stat.read();
+	bool parsed = stat && parse_proc_stat(stat, _procStat);
+
+	for (size_t index = 0; index < _nodes.size(); ++index) {
+		Node &node = _nodes[index];
+		values[2 * index] = node_memory(node);
+		if (!parsed) {
+			continue;
+		}
+		unsigned long long idleTicks = 0, totalTicks = 0;
+		for (int cpu : node.cpus) {
+			if (static_cast<size_t>(cpu) < _procStat.cores.size() && _procStat.online[cpu]) {
+				idleTicks += _procStat.cores[cpu].idle_ticks();
+				totalTicks += _procStat.cores[cpu].total_ticks();
+			}
+		}
+		unsigned long long total = counter_delta(totalTicks, node.totalTicks);
+		unsigned long long idle = counter_delta(idleTicks, node.idleTicks);
+		values[2 * index + 1] = delta_share(idle <= total ? total - idle : 0, total);
+		node.idleTicks = idleTicks;
+		node.totalTicks = totalTicks;
+	}
+
+	float* modules = values + 2 * _nodes.size();
+	for (size_t module = 0; module < _moduleNodes.size(); ++module) {
+		int node = _moduleNodes[module];
+		modules[module] = node >= 0 ? values[2 * node] : 0;
+	}
+}
+
+//
+// Private methods
+//
+
+// Lines are "Node 0 MemTotal:  16303492 kB". Used memory leaves out the page cache and
+// reclaimable slab, which the kernel gives back when it needs to.
+float NumaActivity::node_memory(Node &node) {
+	const char* pos = node.meminfo.read();
+	if (!pos) {
+		return 0;
+	}
+	unsigned long long total = 0, free = 0, filePages = 0, reclaimable = 0;
+	int found = 0;
+	for (; *pos && found < 4; pos = next_line(pos)) {
+		if (strncmp(pos, "Node ", 5) != 0) {
+			continue;
+		}
+		const char* key = pos + 5;
+		parse_uint(key);
+		key = skip_spaces(key);
+		unsigned long long* value = strncmp(key, "MemTotal:", 9) == 0       ? &total
+		                          : strncmp(key, "MemFree:", 8) == 0        ? &free
+		                          : strncmp(key, "FilePages:", 10) == 0     ? &filePages
+		                          : strncmp(key, "SReclaimable:", 13) == 0  ? &reclaimable
+		                                                                    : nullptr;
+		if (value) {
+			key = strchr(key, ':') + 1;
+			*value = parse_uint(key);
+			++found;
+		}
+	}
+	unsigned long long available = free + filePages + reclaimable;
+	return total > 0 && available <= total ? 100.0f * (total - available) / total : 0;
+}
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef __NumaActivity_h__
+#define __NumaActivity_h__
+
+#include <string>
+#include <vector>
+
+#include "MetricSource.h"
+#include "ProcFile.h"
+#include "ProcStat.h"
+
+using namespace std;
+
+// Memory and CPU use of each NUMA node, from /sys/devices/system/node (Linux only), so a
+// two socket machine shows when one node is full or busy and the other is not. Publishes
+// numa.<node>.memory (% of the node's RAM used, not counting cache, as memory.used does)
+// and numa.<node>.load (% busy of the node's CPUs), and memory.module.<n>, which is the
+// memory of the node each memory module is assigned to.
+//
+// Machines with a single node publish nothing, and the RAM sticks show the whole machine.
+class NumaActivity : public MetricSource {
+	struct Node {
+		int id;
+		ProcFile meminfo;
+		vector<int> cpus;
+		unsigned long long idleTicks, totalTicks;
+	};
+	vector<Node> _nodes;
+	// Index in _nodes of each memory module's node, -1 if it names no node
+	vector<int> _moduleNodes;
+	ProcFile _stat;
+	ProcStat _procStat;
+
+	float node_memory(Node &node);
+
+  public:
+	// moduleCount is the number of memory modules on the rig, and modules has the node of
+	// each, in the order of the layout's sticks. Empty spreads them evenly over the nodes.
+	// The roots are only changed to point the source at a copy of the files, for benchmarks.
+	NumaActivity(int moduleCount, const vector<int> &modules = {}, const string &sysRoot = "/sys",
+	             const string &procRoot = "/proc");
+	vector<MetricInfo> metrics() override;
+	int sample_cost_us() override;
+	void sample(float* values) override;
+};
+
+#endif
@@ -0,0 +1,192 @@
+#include "PerfActivity.h"
+
+#ifndef _WIN32
+
+#include <algorithm>
+#include <errno.h>
+#include <iostream>
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Type and config of each Event, in the same order
+static const struct {
+	unsigned int type;
+	unsigned long long config;
+} events[] = {
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+	{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+	{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+};
+
+// Hardware counters first, and the software events alone if no CPU has any. Offline
+// CPUs fail to open and are left out.
+PerfActivity::PerfActivity() {
+	int cpus = static_cast<int>(sysconf(_SC_NPROCESSORS_CONF));
+	_read.resize(3 + E_Count);
+	int hardwareError = 0;
+	for (int first : { E_Cycles, E_ContextSwitches }) {
+		for (int cpu = 0; cpu < cpus; ++cpu) {
+			Cpu group = {};
+			group.cpu = cpu;
+			if (open_group(group, first)) {
+				_cpus.push_back(move(group));
+			}
+		}
+		if (!_cpus.empty()) {
+			_first = first;
+			break;
+		}
+		if (first == E_Cycles) {
+			hardwareError = errno;
+		}
+	}
+	if (_cpus.empty()) {
+		cout << "Opening perf events failed (" << strerror(errno) << "), not showing perf.*";
+		if (errno == EACCES || errno == EPERM) {
+			cout << ", they need CAP_PERFMON or kernel.perf_event_paranoid <= 0";
+		}
+		cout << endl;
+	}
+	else if (_first != E_Cycles) {
+		cout << "No hardware perf counters (" << strerror(hardwareError) << "), showing software events only" << endl;
+	}
+}
+
+PerfActivity::~PerfActivity() {
+	for (auto &cpu : _cpus) {
+		for (int fd : cpu.fds) {
+			close(fd);
+		}
+	}
+}
+
+bool PerfActivity::hardware() const {
+	return !_cpus.empty() && _first == E_Cycles;
+}
+
+vector<MetricInfo> PerfActivity::metrics() {
+	vector<MetricInfo> infos;
+	if (_cpus.empty()) {
+		return infos;
+	}
+	if (hardware()) {
+		infos.push_back({"perf.ipc", "", 2});
+		infos.push_back({"perf.cache_miss_rate", "%", 1});
+		infos.push_back({"perf.cache_misses", "/s", 0});
+	}
+	infos.push_back({"perf.context_switches", "/s", 0});
+	infos.push_back({"perf.page_faults", "/s", 0});
+	if (hardware()) {
+		for (const auto &cpu : _cpus) {
+			infos.push_back({"perf." + to_string(cpu.cpu) + ".ipc", "", 2});
+		}
+	}
+	return infos;
+}
+
+// A read per CPU, each an IPI to that CPU when it is not the one reading
+int PerfActivity::sample_cost_us() {
+	return 5 + 2 * static_cast<int>(_cpus.size());
+}
+
+void PerfActivity::sample(float* values) {
+	if (_cpus.empty()) {
+		return;
+	}
+	_clock.advance(chrono::steady_clock::now());
+	bool rates = _clock.ready();
+	int perCpu = hardware() ? 5 : 2;
+	double totals[E_Count] = {};
+
+	for (size_t index = 0; index < _cpus.size(); ++index) {
+		Cpu &cpu = _cpus[index];
+		ssize_t length = ::read(cpu.fds[0], _read.data(), _read.size() * sizeof(_read[0]));
+		if (length < static_cast<ssize_t>(3 * sizeof(_read[0]))) {
+			if (hardware()) {
+				values[perCpu + index] = 0;
+			}
+			cpu.missed = true;
+			continue;
+		}
+		unsigned long long count = min<unsigned long long>(_read[0], E_Count - _first);
+		// While multiplexed the group only counted for part of the interval, so the counts
+		// are scaled up to all of it. Ratios between events of the group are not affected.
+		unsigned long long enabled = counter_delta(_read[1], cpu.enabled);
+		unsigned long long running = counter_delta(_read[2], cpu.running);
+		double scale = running > 0 ? static_cast<double>(enabled) / running : 0;
+		cpu.enabled = _read[1];
+		cpu.running = _read[2];
+
+		double deltas[E_Count] = {};
+		for (unsigned long long event = 0; event < count; ++event) {
+			unsigned long long value = _read[3 + event];
+			deltas[_first + event] = counter_delta(value, cpu.counts[_first + event]) * scale;
+			cpu.counts[_first + event] = value;
+		}
+		if (cpu.missed) {
+			cpu.missed = false;
+			continue;
+		}
+		for (int event = _first; event < E_Count; ++event) {
+			totals[event] += deltas[event];
+		}
+		if (rates && hardware()) {
+			values[perCpu + index] = deltas[E_Cycles] > 0 ? deltas[E_Instructions] / deltas[E_Cycles] : 0;
+		}
+	}
+
+	if (!rates) {
+		return;
+	}
+	double seconds = _clock.seconds();
+	if (hardware()) {
+		values[0] = totals[E_Cycles] > 0 ? totals[E_Instructions] / totals[E_Cycles] : 0;
+		values[1] = totals[E_CacheReferences] > 0 ? 100 * totals[E_CacheMisses] / totals[E_CacheReferences] : 0;
+		values[2] = totals[E_CacheMisses] / seconds;
+		values += 3;
+	}
+	values[0] = totals[E_ContextSwitches] / seconds;
+	values[1] = totals[E_PageFaults] / seconds;
+}
+
+//
+// Private methods
+//
+
+// The leader starts disabled and is enabled once the whole group is open, so every event
+// counts from the same moment
+bool PerfActivity::open_group(Cpu &cpu, int first) {
+	for (int event = first; event < E_Count; ++event) {
+		perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = events[event].type;
+		attr.config = events[event].config;
+		attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		attr.disabled = event == first;
+		int leader = event == first ? -1 : cpu.fds[0];
+		int fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, -1, cpu.cpu, leader, PERF_FLAG_FD_CLOEXEC));
+		if (fd < 0) {
+			int error = errno;
+			for (int opened : cpu.fds) {
+				close(opened);
+			}
+			cpu.fds.clear();
+			errno = error;
+			return false;
+		}
+		cpu.fds.push_back(fd);
+	}
+	ioctl(cpu.fds[0], PERF_EVENT_IOC_ENABLE, 0);
+	return true;
+}
+
+#endif
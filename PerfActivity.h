@@ -0,0 +1,53 @@
+#ifndef __PerfActivity_h__
+#define __PerfActivity_h__
+
+#include <vector>
+
+#include "MetricSource.h"
+#include "Rate.h"
+
+using namespace std;
+
+// How well the cores are doing their work, not just how busy they are, from perf events
+// counted on every CPU (Linux only). With hardware counters it publishes perf.ipc
+// (instructions per cycle across all CPUs), perf.<cpu>.ipc, perf.cache_miss_rate (% of
+// cache references that missed) and perf.cache_misses per second. perf.context_switches
+// and perf.page_faults per second come from software events, which are all there is in
+// most VMs.
+//
+// The events of a CPU are one group, so they are counted over the same time and read
+// together with one read(). Opening them needs CAP_PERFMON, or kernel.perf_event_paranoid
+// at 0 or below; without it the source publishes nothing.
+class PerfActivity : public MetricSource {
+	// Events are at fixed positions, so the metrics can find them whichever are open
+	enum Event { E_Cycles, E_Instructions, E_CacheReferences, E_CacheMisses, E_ContextSwitches, E_PageFaults,
+	             E_Count };
+	struct Cpu {
+		int cpu;
+		vector<int> fds;               // group leader first
+		// Counts at the previous read, and the times the group was enabled and running,
+		// which differ when the kernel multiplexes more events than there are counters
+		unsigned long long counts[E_Count];
+		unsigned long long enabled, running;
+		// The last read failed, so the next one only takes the counts, not their deltas
+		bool missed;
+	};
+	vector<Cpu> _cpus;
+	// First event of the group, E_ContextSwitches when there are no hardware counters
+	int _first = E_Cycles;
+	RateClock _clock;
+	// Buffer for a group read: the event count, both times, then a value per event
+	vector<unsigned long long> _read;
+
+	bool open_group(Cpu &cpu, int first);
+
+  public:
+	PerfActivity();
+	~PerfActivity();
+	bool hardware() const;
+	vector<MetricInfo> metrics() override;
+	int sample_cost_us() override;
+	void sample(float* values) override;
+};
+
+#endif
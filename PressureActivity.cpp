@@ -0,0 +1,170 @@
+#include "PressureActivity.h"
+
+#ifndef _WIN32
+
+#include <algorithm>
+#include <fcntl.h>
+#include <iostream>
+#include <string.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Stall share within the window that fires a trigger
+static const int triggerPercent = 10;
+
+// Trigger windows to try, the kernel only lets unprivileged users use whole multiples
+// of 2 seconds
+static const chrono::microseconds triggerWindows[] = { chrono::seconds(1), chrono::seconds(2) };
+
+// Parses the "12.34" style decimal after key in line, or 0 if the key is missing
+static float parse_field(const char* line, const char* end, const char* key) {
+	const char* pos = strstr(line, key);
+	if (!pos || pos >= end) {
+		return 0;
+	}
+	pos += strlen(key);
+	return parse_decimal(pos);
+}
+
+PressureActivity::PressureActivity(const string &procRoot) {
+	bool triggers = true;
+	for (const char* name : { "cpu", "memory", "io" }) {
+		string path = procRoot + "/pressure/" + name;
+		Resource resource{ name, ProcFile(path, 256), {}, {}, -1, false };
+		const char* pos = resource.file.read();
+		if (!pos) {
+			continue;
+		}
+		// Lines are "some avg10=0.00 avg60=0.00 avg300=0.00 total=0", then the same for "full"
+		while (*pos) {
+			const char* space = strchr(pos, ' ');
+			if (!space) {
+				break;
+			}
+			resource.kinds.push_back(string(pos, space));
+			resource.totalUs.push_back(0);
+			pos = next_line(pos);
+		}
+		triggers = add_trigger(resource, path) && triggers;
+		_resources.push_back(move(resource));
+	}
+	if (_resources.empty()) {
+		cout << "No /proc/pressure, the kernel was built without PSI or booted with psi=0" << endl;
+	}
+	else if (!triggers) {
+		cout << "Registering PSI triggers failed, stalls will show at the next sample" << endl;
+	}
+}
+
+PressureActivity::~PressureActivity() {
+	for (auto &resource : _resources) {
+		if (resource.triggerFd >= 0) {
+			close(resource.triggerFd);
+		}
+	}
+}
+
+vector<MetricInfo> PressureActivity::metrics() {
+	vector<MetricInfo> infos;
+	for (const auto &resource : _resources) {
+		for (const auto &kind : resource.kinds) {
+			string prefix = "psi." + resource.name + "." + kind;
+			infos.push_back({prefix, "%", 1});
+			infos.push_back({prefix + ".avg10", "%", 1});
+		}
+	}
+	return infos;
+}
+
+chrono::milliseconds PressureActivity::sample_period() {
+	if (!_stalled) {
+		return defaultSamplePeriod;
+	}
+	return chrono::duration_cast<chrono::milliseconds>(_window.count() > 0 ? _window : triggerWindows[0]);
+}
+
+// A pread of each of the three small files
+int PressureActivity::sample_cost_us() {
+	return 6;
+}
+
+void PressureActivity::sample(float* values) {
+	// The three files are read within microseconds of each other, so one clock does for all
+	_clock.advance(chrono::steady_clock::now());
+	bool rates = _clock.ready();
+	double elapsedUs = _clock.seconds() * 1e6;
+	_stalled = false;
+	for (auto &resource : _resources) {
+		const char* pos = resource.file.read();
+		for (size_t kind = 0; kind < resource.kinds.size(); ++kind, values += 2) {
+			if (!pos || !*pos) {
+				continue;
+			}
+			const char* line = pos;
+			pos = next_line(pos);
+			const char* total = strstr(line, "total=");
+			if (!total || total >= pos) {
+				continue;
+			}
+			total += strlen("total=");
+			unsigned long long totalUs = parse_uint(total);
+			if (rates) {
+				// After a trigger the stall since the previous sample is still spread over all of
+				// it. The next sample is one window later, and shows the stall of that window.
+				float share = min(100.0, counter_delta(totalUs, resource.totalUs[kind]) * 100 / elapsedUs);
+				values[0] = share;
+				_stalled = _stalled || share >= triggerPercent || resource.triggered;
+			}
+			values[1] = parse_field(line, pos, "avg10=");
+			resource.totalUs[kind] = totalUs;
+		}
+		resource.triggered = false;
+	}
+}
+
+vector<int> PressureActivity::wake_fds() {
+	vector<int> fds;
+	for (const auto &resource : _resources) {
+		if (resource.triggerFd >= 0) {
+			fds.push_back(resource.triggerFd);
+		}
+	}
+	return fds;
+}
+
+void PressureActivity::wake(int fd) {
+	for (auto &resource : _resources) {
+		if (resource.triggerFd == fd) {
+			resource.triggered = true;
+		}
+	}
+}
+
+//
+// Private methods
+//
+
+// A trigger is a "some <stall us> <window us>" line written to the pressure file. Each
+// open file holds one trigger, and polls with POLLPRI when it fires.
+bool PressureActivity::add_trigger(Resource &resource, const string &path) {
+	for (auto window : triggerWindows) {
+		if (_window.count() > 0 && window != _window) {
+			continue;
+		}
+		int fd = open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+		if (fd < 0) {
+			return false;
+		}
+		string trigger = "some " + to_string(window.count() * triggerPercent / 100) + " " + to_string(window.count());
+		if (write(fd, trigger.c_str(), trigger.size() + 1) >= 0) {
+			resource.triggerFd = fd;
+			_window = window;
+			return true;
+		}
+		close(fd);
+	}
+	return false;
+}
+
+#endif
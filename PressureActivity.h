@@ -0,0 +1,51 @@
+#ifndef __PressureActivity_h__
+#define __PressureActivity_h__
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "MetricSource.h"
+#include "ProcFile.h"
+#include "Rate.h"
+
+using namespace std;
+
+// Pressure stall information from /proc/pressure/{cpu,memory,io} (Linux only): the share
+// of time tasks were stalled waiting on each resource. Publishes psi.<resource>.<some|full>,
+// the % of time stalled since the previous sample, and the kernel's own 10 second average
+// as psi.<resource>.<some|full>.avg10.
+//
+// A kernel trigger on each resource's "some" line wakes the registry as soon as tasks
+// stall for 10% of a one second window (two seconds where the kernel only allows that),
+// so stalls show without sampling often. After a trigger, and while a resource is stalled,
+// it is sampled once per window, to measure the stall and see when it ends.
+class PressureActivity : public MetricSource {
+	struct Resource {
+		string name;
+		ProcFile file;
+		vector<string> kinds;                // "some", and "full" if the kernel has it
+		vector<unsigned long long> totalUs;  // stall time so far, per kind
+		int triggerFd;
+		bool triggered;                      // woken by the trigger since the previous sample
+	};
+	vector<Resource> _resources;
+	chrono::microseconds _window{0};
+	bool _stalled = false;
+	RateClock _clock;
+
+	bool add_trigger(Resource &resource, const string &path);
+
+  public:
+	// The root is only changed to point the source at a copy of the files, for benchmarks
+	PressureActivity(const string &procRoot = "/proc");
+	~PressureActivity();
+	vector<MetricInfo> metrics() override;
+	chrono::milliseconds sample_period() override;
+	int sample_cost_us() override;
+	void sample(float* values) override;
+	vector<int> wake_fds() override;
+	void wake(int fd) override;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#include "ProcFile.h"
+
+#ifndef _WIN32
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+unsigned long long ProcFile::_syscalls = 0;
+
+ProcFile::ProcFile(const string &path, size_t initialSize) : _buf(initialSize) {
+	_fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+}
+
+ProcFile::ProcFile(ProcFile &&other)
+	: _fd(other._fd), _buf(move(other._buf)), _ready(other._ready), _readTime(other._readTime) {
+	other._fd = -1;
+}
+
+ProcFile::~ProcFile() {
+	if (_fd >= 0) {
+		close(_fd);
+	}
+}
+
+bool ProcFile::is_open() const {
+	return _fd >= 0;
+}
+
+const char* ProcFile::read(size_t &length) {
+	length = 0;
+	if (_fd < 0) {
+		return nullptr;
+	}
+	if (_ready >= 0) {
+		length = _ready;
+		_ready = -1;
+		return _buf.data();
+	}
+	// procfs and sysfs fill as much of the buffer as the file has, so a short read is the
+	// end of the file and the common case is a single pread
+	while (true) {
+		size_t space = _buf.size() - 1 - length;
+		ssize_t n = pread(_fd, _buf.data() + length, space, length);
+		++_syscalls;
+		if (n < 0) {
+			return nullptr;
+		}
+		length += n;
+		if (static_cast<size_t>(n) < space) {
+			break;
+		}
+		_buf.resize(_buf.size() * 2);
+	}
+	_buf[length] = '\0';
+	_readTime = chrono::steady_clock::now();
+	return _buf.data();
+}
+
+const char* ProcFile::read() {
+	size_t length;
+	return read(length);
+}
+
+chrono::steady_clock::time_point ProcFile::read_time() const {
+	return _readTime;
+}
+
+unsigned long long ProcFile::syscall_count() {
+	return _syscalls;
+}
+
+#endif
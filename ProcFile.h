@@ -0,0 +1,81 @@
+#ifndef __ProcFile_h__
+#define __ProcFile_h__
+
+#include <chrono>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// A procfs or sysfs file kept open for the life of the object and re-read from the
+// start with pread, so sampling costs one syscall and no path lookup
+class ProcFile {
+	int _fd = -1;
+	vector<char> _buf;
+	// Length of a read already done by a ReadBatch, which the next read() returns, or -1
+	long _ready = -1;
+	chrono::steady_clock::time_point _readTime;
+
+	friend class ReadBatch;
+	static unsigned long long _syscalls;
+
+  public:
+	ProcFile(const string &path, size_t initialSize = 4096);
+	ProcFile(ProcFile &&other);
+	ProcFile(const ProcFile &) = delete;
+	ProcFile& operator=(const ProcFile &) = delete;
+	~ProcFile();
+	bool is_open() const;
+	// The whole file, null terminated, or nullptr if it can not be read. The buffer is
+	// reused between reads and only reallocated if the file outgrows it.
+	const char* read(size_t &length);
+	const char* read();
+	// When the latest read() was made, for the RateClock of the counters parsed from it
+	chrono::steady_clock::time_point read_time() const;
+	// Reads made by every ProcFile and ReadBatch so far, for the benchmarks
+	static unsigned long long syscall_count();
+};
+
+//
+// Parsing helpers for the space separated numbers procfs is made of
+//
+
+inline const char* skip_spaces(const char* pos) {
+	while (*pos == ' ' || *pos == '\t') {
+		++pos;
+	}
+	return pos;
+}
+
+// Parses the unsigned decimal at pos, after any leading spaces, and moves pos past it
+inline unsigned long long parse_uint(const char* &pos) {
+	pos = skip_spaces(pos);
+	unsigned long long value = 0;
+	while (*pos >= '0' && *pos <= '9') {
+		value = value * 10 + (*pos - '0');
+		++pos;
+	}
+	return value;
+}
+
+// Same for decimals such as the "12.34" of PSI averages
+inline float parse_decimal(const char* &pos) {
+	float value = static_cast<float>(parse_uint(pos));
+	if (*pos == '.') {
+		float scale = 0.1f;
+		for (++pos; *pos >= '0' && *pos <= '9'; ++pos, scale /= 10) {
+			value += (*pos - '0') * scale;
+		}
+	}
+	return value;
+}
+
+// strchr rather than a loop, since libc scans for the newline many bytes at a time and
+// some lines, such as intr in /proc/stat, run to thousands of characters
+inline const char* next_line(const char* pos) {
+	const char* end = strchr(pos, '\n');
+	return end ? end + 1 : pos + strlen(pos);
+}
+
+#endif
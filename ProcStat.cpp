@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <string.h>
+
+#include "ProcFile.h"
+#include "ProcStat.h"
+
+using namespace std;
+
+ProcStat::ProcStat(int cpuCount) : total(), cores(cpuCount), online(cpuCount), contextSwitches(0), interrupts(0),
+                                   procsRunning(0), procsBlocked(0) {
+}
+
+static const char* parse_cpu_times(const char* pos, CpuTimes &times) {
+	times.user = parse_uint(pos);
+	times.nice = parse_uint(pos);
+	times.system = parse_uint(pos);
+	times.idle = parse_uint(pos);
+	times.iowait = parse_uint(pos);
+	times.irq = parse_uint(pos);
+	times.softirq = parse_uint(pos);
+	times.steal = parse_uint(pos);
+	return pos;
+}
+
+static bool starts_with(const char* pos, const char* prefix, size_t length) {
+	return strncmp(pos, prefix, length) == 0;
+}
+
+// Lines are told apart by their first letters, and each is parsed as far as needed and
+// then skipped. intr is a total followed by a count for every IRQ, thousands of numbers
+// on big machines, so only the total is parsed and next_line() skips the rest.
+bool parse_proc_stat(const char* pos, ProcStat &stat) {
+	if (!starts_with(pos, "cpu ", 4)) {
+		return false;
+	}
+	fill(stat.online.begin(), stat.online.end(), 0);
+	while (*pos) {
+		switch (*pos) {
+		case 'c':
+			if (starts_with(pos, "cpu", 3)) {
+				pos += 3;
+				if (*pos == ' ') {
+					pos = parse_cpu_times(pos, stat.total);
+				}
+				else {
+					size_t cpu = parse_uint(pos);
+					if (cpu >= stat.cores.size()) {
+						stat.cores.resize(cpu + 1);
+						stat.online.resize(cpu + 1);
+					}
+					pos = parse_cpu_times(pos, stat.cores[cpu]);
+					stat.online[cpu] = 1;
+				}
+			}
+			else if (starts_with(pos, "ctxt ", 5)) {
+				pos += 5;
+				stat.contextSwitches = parse_uint(pos);
+			}
+			break;
+		case 'i':
+			if (starts_with(pos, "intr ", 5)) {
+				pos += 5;
+				stat.interrupts = parse_uint(pos);
+			}
+			break;
+		case 'p':
+			if (starts_with(pos, "procs_running ", 14)) {
+				pos += 14;
+				stat.procsRunning = parse_uint(pos);
+			}
+			else if (starts_with(pos, "procs_blocked ", 14)) {
+				pos += 14;
+				stat.procsBlocked = parse_uint(pos);
+			}
+			break;
+		}
+		pos = next_line(pos);
+	}
+	return true;
+}
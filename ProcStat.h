@@ -0,0 +1,36 @@
+#ifndef __ProcStat_h__
+#define __ProcStat_h__
+
+#include <vector>
+
+using namespace std;
+
+// One cpu line of /proc/stat, in USER_HZ ticks. guest and guest_nice are left out, as
+// they are already counted in user and nice.
+struct CpuTimes {
+	unsigned long long user, nice, system, idle, iowait, irq, softirq, steal;
+
+	unsigned long long idle_ticks() const { return idle + iowait; }
+	unsigned long long total_ticks() const { return user + nice + system + idle + iowait + irq + softirq + steal; }
+};
+
+// Everything the sources use from /proc/stat
+struct ProcStat {
+	CpuTimes total;
+	// By CPU number. Offline CPUs have no line, and are marked so in online.
+	vector<CpuTimes> cores;
+	vector<char> online;
+	unsigned long long contextSwitches;
+	unsigned long long interrupts;
+	unsigned long long procsRunning;
+	unsigned long long procsBlocked;
+
+	// Sized for cpuCount CPUs up front, so parsing does not allocate
+	ProcStat(int cpuCount = 0);
+};
+
+// Fills stat from the text of /proc/stat in a single pass over it. Only allocates if a CPU
+// number is past the size of stat.cores, after CPU hotplug.
+bool parse_proc_stat(const char* pos, ProcStat &stat);
+
+#endif
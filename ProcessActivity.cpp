@@ -0,0 +1,370 @@
+#include "ProcessActivity.h"
+#include "ProcFile.h"
+
+#ifndef _WIN32
+
+#include <algorithm>
+#include <fcntl.h>
+#include <iomanip>
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Processes that used no CPU at their last read are re-read on one scan in this many,
+// staggered by pid so each scan reads a similar share of them
+static const unsigned int idleRescan = 4;
+
+// fds left free for everything else once the stat files have theirs, and the most of the
+// limit the stat files may hold however many are free
+static const int reservedFds = 256;
+static const int budgetShare = 2;
+
+// A full scan of 20000 processes measures 20 to 30 ms
+static const int scanCostPerProcessNs = 1000;
+
+// glibc only wraps getdents64 from 2.30, so it is called directly
+struct linux_dirent64 {
+	unsigned long long d_ino;
+	long long d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[];
+};
+
+// Counts the fds this process has open, from /proc/self/fd
+static int open_fd_count() {
+	int fd = open("/proc/self/fd", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0) {
+		return -1;
+	}
+	char buffer[16 * 1024];
+	int count = 0;
+	while (true) {
+		long bytes = syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+		if (bytes <= 0) {
+			break;
+		}
+		for (long offset = 0; offset < bytes;) {
+			auto entry = reinterpret_cast<linux_dirent64*>(buffer + offset);
+			offset += entry->d_reclen;
+			count += entry->d_name[0] >= '0' && entry->d_name[0] <= '9';
+		}
+	}
+	close(fd);
+	// Not counting the fd used to list them
+	return count - 1;
+}
+
+static long long steady_ns() {
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Like parse_uint, for the few stat fields that can be negative (priority, nice)
+static unsigned long long next_field(const char* &pos) {
+	pos = skip_spaces(pos);
+	if (*pos == '-') {
+		++pos;
+	}
+	return parse_uint(pos);
+}
+
+// How many stat files may be kept open is worked out from the fd limit at the first
+// scan, once the other sources have opened theirs. The limit is left as it is, so with
+// the usual soft limit of 1024 a few hundred are kept, and processes past the budget are
+// still read, opening their file each time.
+ProcessActivity::ProcessActivity(int count, const string &procRoot)
+	: _procRoot(procRoot), _dirents(64 * 1024), _count(count) {
+	_procFd = open(procRoot.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (_procFd < 0) {
+		cout << "Opening " << procRoot << " failed, not showing top processes" << endl;
+		_count = 0;
+		return;
+	}
+	struct rlimit limit;
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+		_fdLimit = static_cast<int>(min<rlim_t>(limit.rlim_cur, 1 << 20));
+	}
+	_ticksPerSecond = sysconf(_SC_CLK_TCK);
+
+	// One listing up front, so the cost reflects the size of the scan
+	int pids = 0;
+	lseek(_procFd, 0, SEEK_SET);
+	while (true) {
+		long bytes = syscall(SYS_getdents64, _procFd, _dirents.data(), _dirents.size());
+		if (bytes <= 0) {
+			break;
+		}
+		for (long offset = 0; offset < bytes;) {
+			auto entry = reinterpret_cast<linux_dirent64*>(_dirents.data() + offset);
+			offset += entry->d_reclen;
+			pids += entry->d_name[0] >= '0' && entry->d_name[0] <= '9';
+		}
+	}
+	_costUs = max(100, static_cast<int>(static_cast<long long>(pids) * scanCostPerProcessNs / 1000));
+	grow_pool(max<size_t>(1024, pids + pids / 2));
+	_top.reserve(_count);
+}
+
+ProcessActivity::~ProcessActivity() {
+	for (const auto &process : _processes) {
+		if (process.pid && process.fd >= 0) {
+			close(process.fd);
+		}
+	}
+	if (_procFd >= 0) {
+		close(_procFd);
+	}
+}
+
+vector<MetricInfo> ProcessActivity::metrics() {
+	vector<MetricInfo> infos;
+	for (int rank = 1; rank <= _count; ++rank) {
+		infos.push_back({"top." + to_string(rank) + ".cpu", "%", 1});
+	}
+	return infos;
+}
+
+// A pread per process on most scans, which on a big host is the most expensive source
+int ProcessActivity::sample_cost_us() {
+	return _costUs;
+}
+
+void ProcessActivity::sample(float* values) {
+	if (_procFd < 0) {
+		return;
+	}
+	if (_fdBudget < 0) {
+		int inUse = open_fd_count();
+		_fdBudget = inUse < 0 ? 0 : max(0, min(_fdLimit - inUse - reservedFds, _fdLimit / budgetShare));
+	}
+	long long nowNs = steady_ns();
+	++_generation;
+	_top.clear();
+	auto busier = [](const Top &a, const Top &b) { return a.cpu > b.cpu; };
+
+	lseek(_procFd, 0, SEEK_SET);
+	while (true) {
+		long bytes = syscall(SYS_getdents64, _procFd, _dirents.data(), _dirents.size());
+		if (bytes <= 0) {
+			break;
+		}
+		for (long offset = 0; offset < bytes;) {
+			auto entry = reinterpret_cast<linux_dirent64*>(_dirents.data() + offset);
+			offset += entry->d_reclen;
+			const char* name = entry->d_name;
+			if (*name < '0' || *name > '9') {
+				continue;
+			}
+			int pid = static_cast<int>(parse_uint(name));
+
+			int slot = find_slot(pid);
+			Process &process = slot >= 0 ? _processes[slot] : add_process(pid);
+			process.generation = _generation;
+			if (process.primed && process.cpu == 0 && (pid + _generation) % idleRescan != 0) {
+				continue;
+			}
+			if (!read_process(pid, process, nowNs) || process.cpu <= 0) {
+				continue;
+			}
+
+			// Bounded min-heap: the least busy of the top is at the front, ready to be replaced
+			if (static_cast<int>(_top.size()) < _count) {
+				_top.push_back(Top{ pid, process.cpu, {} });
+				memcpy(_top.back().name, process.name, sizeof(process.name));
+				push_heap(_top.begin(), _top.end(), busier);
+			}
+			else if (_count > 0 && process.cpu > _top.front().cpu) {
+				pop_heap(_top.begin(), _top.end(), busier);
+				_top.back() = Top{ pid, process.cpu, {} };
+				memcpy(_top.back().name, process.name, sizeof(process.name));
+				push_heap(_top.begin(), _top.end(), busier);
+			}
+		}
+	}
+
+	// Processes that were not listed this time have exited
+	for (size_t slot = 0; slot < _processes.size(); ++slot) {
+		if (_processes[slot].pid && _processes[slot].generation != _generation) {
+			remove_process(static_cast<int>(slot));
+		}
+	}
+
+	sort(_top.begin(), _top.end(), busier);
+	for (int rank = 0; rank < _count; ++rank) {
+		values[rank] = rank < static_cast<int>(_top.size()) ? _top[rank].cpu : 0;
+	}
+}
+
+void ProcessActivity::print_status(ostream &out) {
+	if (_top.empty()) {
+		return;
+	}
+	out << ", top:";
+	for (size_t rank = 0; rank < _top.size(); ++rank) {
+		out << (rank ? ", " : " ") << _top[rank].name << " (" << _top[rank].pid << ") "
+		    << fixed << setprecision(1) << _top[rank].cpu << "%";
+	}
+}
+
+size_t ProcessActivity::process_count() const {
+	return _processes.size() - _freeSlots.size();
+}
+
+//
+// Private methods
+//
+
+// stat is "pid (comm) state ppid pgrp ... utime stime ..." where comm can itself hold
+// spaces and parentheses, so fields are counted from the last ')'
+bool ProcessActivity::read_process(int pid, Process &process, long long nowNs) {
+	char path[64];
+	if (process.fd < 0) {
+		snprintf(path, sizeof(path), "%s/%d/stat", _procRoot.c_str(), pid);
+	}
+	bool keepOpen = process.fd >= 0 || _openFds < _fdBudget;
+	int fd = process.fd >= 0 ? process.fd : open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return false;
+	}
+	ssize_t length = pread(fd, _stat, sizeof(_stat) - 1, 0);
+	if (process.fd < 0) {
+		if (keepOpen && length > 0) {
+			process.fd = fd;
+			++_openFds;
+		}
+		else {
+			close(fd);
+		}
+	}
+	// The process exited, and the pid may already belong to another
+	if (length <= 0) {
+		if (process.fd >= 0) {
+			close(process.fd);
+			process.fd = -1;
+			--_openFds;
+		}
+		process.primed = false;
+		process.cpu = 0;
+		return false;
+	}
+	_stat[length] = '\0';
+
+	const char* nameStart = strchr(_stat, '(');
+	const char* nameEnd = strrchr(_stat, ')');
+	if (!nameStart || !nameEnd || nameEnd < nameStart) {
+		return false;
+	}
+	size_t nameLength = min(static_cast<size_t>(nameEnd - nameStart - 1), sizeof(process.name) - 1);
+	memcpy(process.name, nameStart + 1, nameLength);
+	process.name[nameLength] = '\0';
+
+	// Fields from ppid (4) on, past the state letter. utime and stime are 14 and 15,
+	// starttime is 22.
+	const char* pos = skip_spaces(nameEnd + 1) + 1;
+	unsigned long long fields[23] = {};
+	for (int field = 4; field <= 22; ++field) {
+		fields[field] = next_field(pos);
+	}
+	unsigned long long cpuTicks = fields[14] + fields[15];
+	if (process.primed && process.startTime == fields[22] && nowNs > process.readNs && cpuTicks >= process.cpuTicks) {
+		process.cpu = 100.0f * (cpuTicks - process.cpuTicks) / _ticksPerSecond / ((nowNs - process.readNs) / 1e9f);
+	}
+	else {
+		process.cpu = 0;
+	}
+	process.cpuTicks = cpuTicks;
+	process.startTime = fields[22];
+	process.readNs = nowNs;
+	process.primed = true;
+	return true;
+}
+
+// Pids are handed out in order, so the low bits spread them well enough on their own
+int ProcessActivity::find_slot(int pid) const {
+	size_t mask = _slotByPid.size() - 1;
+	for (size_t i = pid & mask;; i = (i + 1) & mask) {
+		int slot = _slotByPid[i];
+		if (slot < 0 || _processes[slot].pid == pid) {
+			return slot;
+		}
+	}
+}
+
+ProcessActivity::Process &ProcessActivity::add_process(int pid) {
+	if (_freeSlots.empty()) {
+		grow_pool(_processes.size() * 2);
+	}
+	int slot = _freeSlots.back();
+	_freeSlots.pop_back();
+	Process &process = _processes[slot];
+	process = Process{};
+	process.pid = pid;
+	process.fd = -1;
+	size_t mask = _slotByPid.size() - 1;
+	size_t i = pid & mask;
+	while (_slotByPid[i] >= 0) {
+		i = (i + 1) & mask;
+	}
+	_slotByPid[i] = slot;
+	return process;
+}
+
+// Entries after the removed one that probed past it are moved back into the gap, so
+// lookups never need to skip over removed entries
+void ProcessActivity::remove_process(int slot) {
+	Process &process = _processes[slot];
+	if (process.fd >= 0) {
+		close(process.fd);
+		--_openFds;
+	}
+	size_t mask = _slotByPid.size() - 1;
+	size_t gap = process.pid & mask;
+	while (_slotByPid[gap] != slot) {
+		gap = (gap + 1) & mask;
+	}
+	for (size_t i = (gap + 1) & mask; _slotByPid[i] >= 0; i = (i + 1) & mask) {
+		size_t home = _processes[_slotByPid[i]].pid & mask;
+		// Whether home is outside (gap, i], going round the end of the table
+		if (gap <= i ? (home <= gap || home > i) : (home <= gap && home > i)) {
+			_slotByPid[gap] = _slotByPid[i];
+			gap = i;
+		}
+	}
+	_slotByPid[gap] = -1;
+	process.pid = 0;
+	_freeSlots.push_back(slot);
+}
+
+// Only called when the pool is full, so it only allocates when there are more processes
+// than ever before
+void ProcessActivity::grow_pool(size_t slots) {
+	size_t used = _processes.size();
+	_processes.resize(slots);
+	_freeSlots.reserve(slots);
+	for (size_t slot = slots; slot-- > used;) {
+		_processes[slot].pid = 0;
+		_freeSlots.push_back(static_cast<int>(slot));
+	}
+	size_t indexSize = 1;
+	while (indexSize < slots * 2) {
+		indexSize *= 2;
+	}
+	_slotByPid.assign(indexSize, -1);
+	size_t mask = indexSize - 1;
+	for (size_t slot = 0; slot < used; ++slot) {
+		if (_processes[slot].pid) {
+			size_t i = _processes[slot].pid & mask;
+			while (_slotByPid[i] >= 0) {
+				i = (i + 1) & mask;
+			}
+			_slotByPid[i] = static_cast<int>(slot);
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef __ProcessActivity_h__
+#define __ProcessActivity_h__
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "MetricSource.h"
+
+using namespace std;
+
+// The processes using the most CPU, from /proc/[pid]/stat (Linux only). Publishes
+// top.<rank>.cpu as % of one core, like top, and prints their names in the status line.
+//
+// Built for hosts with tens of thousands of processes: /proc is listed with getdents
+// into a reused buffer, each process's stat file is opened once and re-read with pread,
+// and processes that used no CPU last time are only re-read every few scans. CPU they
+// use in between still counts, at the scan that reads it. Processes live in a pool of
+// slots found by pid, so processes starting and exiting do not allocate once the pool
+// has grown to the most processes seen.
+class ProcessActivity : public MetricSource {
+	struct Process {
+		int pid;                          // 0 for a free slot
+		int fd;                           // -1 when out of fds, then opened for each read
+		unsigned long long cpuTicks;      // utime + stime
+		unsigned long long startTime;     // tells a reused pid from the process it replaced
+		long long readNs;                 // steady time of the last read
+		unsigned int generation;          // scan that last saw the pid in /proc
+		bool primed;
+		float cpu;
+		char name[16];
+	};
+	struct Top {
+		int pid;
+		float cpu;
+		char name[16];
+	};
+	string _procRoot;
+	int _procFd = -1;
+	vector<char> _dirents;
+	char _stat[1024];
+	vector<Process> _processes;
+	vector<int> _freeSlots;
+	// Open addressed by pid, with linear probing: the slot of each process, -1 where empty.
+	// Twice the size of the pool, a power of two.
+	vector<int> _slotByPid;
+	int _fdLimit = 0;
+	// Stat files that may be kept open, -1 until the first scan works it out
+	int _fdBudget = -1;
+	int _openFds = 0;
+	int _costUs = 100;
+	unsigned int _generation = 0;
+	long _ticksPerSecond = 100;
+	int _count;
+	// Min-heap of the top _count while scanning, sorted busiest first afterwards
+	vector<Top> _top;
+
+	bool read_process(int pid, Process &process, long long nowNs);
+	int find_slot(int pid) const;
+	Process &add_process(int pid);
+	void remove_process(int slot);
+	void grow_pool(size_t slots);
+
+  public:
+	// The root is only changed to point the source at a copy of the files, for benchmarks
+	ProcessActivity(int count = 5, const string &procRoot = "/proc");
+	~ProcessActivity();
+	vector<MetricInfo> metrics() override;
+	int sample_cost_us() override;
+	void sample(float* values) override;
+	void print_status(ostream &out) override;
+	// Number of processes being tracked, for the benchmarks
+	size_t process_count() const;
+};
+
+#endif
@@ -0,0 +1,40 @@
+#include <algorithm>
+
+#include "Rate.h"
+
+using namespace std;
+
+unsigned long long counter_delta(unsigned long long current, unsigned long long previous, CounterWrap wrap) {
+	if (current >= previous) {
+		return current - previous;
+	}
+	if (wrap == CW_Wrap32 && previous <= 0xffffffffULL) {
+		return current + (0x100000000ULL - previous);
+	}
+	return 0;
+}
+
+float delta_share(unsigned long long part, unsigned long long whole) {
+	return whole > 0 && part <= whole ? 100.0f * part / whole : 0;
+}
+
+void RateClock::advance(chrono::steady_clock::time_point time) {
+	_previous = _time;
+	_time = time;
+}
+
+bool RateClock::ready() const {
+	return _previous.time_since_epoch().count() > 0 && _time > _previous;
+}
+
+double RateClock::seconds() const {
+	return chrono::duration<double>(_time - _previous).count();
+}
+
+double RateClock::rate(unsigned long long current, unsigned long long previous, CounterWrap wrap) const {
+	return ready() ? counter_delta(current, previous, wrap) / seconds() : 0;
+}
+
+float RateClock::busy_percent(unsigned long long current, unsigned long long previous, double unitsPerSecond) const {
+	return static_cast<float>(min(100.0, rate(current, previous) * 100 / unitsPerSecond));
+}
@@ -0,0 +1,42 @@
+#ifndef __Rate_h__
+#define __Rate_h__
+
+#include <chrono>
+
+using namespace std;
+
+// What a cumulative counter going backwards means
+enum CounterWrap {
+	CW_Reset,       // a 64-bit counter that started over, such as for a re-added device
+	CW_Wrap32       // may be a 32-bit driver counter, which wrapped if it was below 2^32
+};
+
+// Increase of a cumulative counter between two reads. After a reset there is no telling
+// how much of the new value belongs to the interval, so it counts as no increase rather
+// than as a spike.
+unsigned long long counter_delta(unsigned long long current, unsigned long long previous, CounterWrap wrap = CW_Reset);
+
+// Share of one counter's increase in another's, in percent, such as busy ticks of all
+// ticks. 0 if the whole did not move.
+float delta_share(unsigned long long part, unsigned long long whole);
+
+// The times of the latest read of a set of counters and of the read before it, so rates
+// are over the real time between the reads rather than the nominal sample period, which
+// the loop, adaptive periods and wake-ups all stretch and shrink.
+class RateClock {
+	chrono::steady_clock::time_point _time, _previous;
+
+  public:
+	// Starts a new interval, ending at the time of the read just made
+	void advance(chrono::steady_clock::time_point time);
+	// There was an earlier read and time has moved on since, so rates can be worked out
+	bool ready() const;
+	double seconds() const;
+	// Per second increase of a counter over the interval, 0 until ready()
+	double rate(unsigned long long current, unsigned long long previous, CounterWrap wrap = CW_Reset) const;
+	// Share of the interval, in percent, covered by a counter of busy time counting
+	// unitsPerSecond, such as the milliseconds of io_ticks. Capped at 100.
+	float busy_percent(unsigned long long current, unsigned long long previous, double unitsPerSecond) const;
+};
+
+#endif
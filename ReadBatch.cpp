@@ -0,0 +1,195 @@
+#include "ReadBatch.h"
+
+#ifndef _WIN32
+
+#include <algorithm>
+#include <errno.h>
+#include <iostream>
+#include <linux/io_uring.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+// glibc has no io_uring wrappers and liburing is not worth a dependency for one opcode,
+// so the rings are set up and driven with the raw syscalls
+
+ReadBatch::ReadBatch(bool useIoUring, unsigned entries) {
+	_files.reserve(entries);
+	if (useIoUring && !setup(entries)) {
+		cout << "io_uring is not available (" << strerror(errno) << "), reading procfs with pread" << endl;
+	}
+}
+
+ReadBatch::~ReadBatch() {
+	close_ring();
+}
+
+bool ReadBatch::uses_io_uring() const {
+	return _ringFd >= 0;
+}
+
+void ReadBatch::add(ProcFile &file) {
+	if (file.is_open()) {
+		_files.push_back(&file);
+	}
+}
+
+void ReadBatch::read() {
+	if (_ringFd < 0) {
+		return;
+	}
+	// A chunk that fails for good closes the ring, and the rest are left to pread
+	for (size_t first = 0; first < _files.size() && _ringFd >= 0; first += _entries) {
+		read_chunk(first, min<size_t>(_entries, _files.size() - first));
+	}
+}
+
+void ReadBatch::clear() {
+	for (auto file : _files) {
+		file->_ready = -1;
+	}
+	_files.clear();
+}
+
+//
+// Private methods
+//
+
+bool ReadBatch::setup(unsigned entries) {
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+	if (fd < 0) {
+		return false;
+	}
+	_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	// Since 5.4 both rings share one mapping
+	bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+	if (single) {
+		_sqRingSize = _cqRingSize = max(_sqRingSize, _cqRingSize);
+	}
+	_sqRing = mmap(nullptr, _sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (_sqRing == MAP_FAILED) {
+		_sqRing = nullptr;
+		close(fd);
+		return false;
+	}
+	_cqRing = single ? _sqRing
+	                 : mmap(nullptr, _cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+	_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+	_sqes = mmap(nullptr, _sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (_cqRing == MAP_FAILED || _sqes == MAP_FAILED) {
+		int error = errno;
+		if (_cqRing == MAP_FAILED) {
+			_cqRing = nullptr;
+		}
+		if (_sqes == MAP_FAILED) {
+			_sqes = nullptr;
+		}
+		close(fd);
+		errno = error;
+		return false;
+	}
+
+	char* sq = static_cast<char*>(_sqRing);
+	char* cq = static_cast<char*>(_cqRing);
+	_sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+	_sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+	_sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+	_cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+	_cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+	_cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+	_cqes = cq + params.cq_off.cqes;
+	_entries = params.sq_entries;
+	_ringFd = fd;
+	return true;
+}
+
+// Closing the ring cancels any read still in flight. Reads go back to pread.
+void ReadBatch::close_ring() {
+	if (_sqes) {
+		munmap(_sqes, _sqesSize);
+		_sqes = nullptr;
+	}
+	if (_cqRing && _cqRing != _sqRing) {
+		munmap(_cqRing, _cqRingSize);
+	}
+	_cqRing = nullptr;
+	if (_sqRing) {
+		munmap(_sqRing, _sqRingSize);
+		_sqRing = nullptr;
+	}
+	if (_ringFd >= 0) {
+		close(_ringFd);
+		_ringFd = -1;
+	}
+}
+
+// A read that fills the whole buffer may have more behind it, and one that fails is
+// left to pread, which reports the error the usual way. Either way the file is not
+// marked ready and the parser's read() does a plain pread.
+void ReadBatch::read_chunk(size_t first, size_t count) {
+	auto sqes = static_cast<io_uring_sqe*>(_sqes);
+	unsigned tail = *_sqTail;
+	for (size_t i = 0; i < count; ++i) {
+		ProcFile &file = *_files[first + i];
+		unsigned index = tail & *_sqMask;
+		io_uring_sqe &sqe = sqes[index];
+		memset(&sqe, 0, sizeof(sqe));
+		sqe.opcode = IORING_OP_READ;
+		sqe.fd = file._fd;
+		sqe.addr = reinterpret_cast<unsigned long long>(file._buf.data());
+		sqe.len = static_cast<unsigned>(file._buf.size() - 1);
+		sqe.off = 0;
+		sqe.user_data = first + i;
+		_sqArray[index] = index;
+		++tail;
+	}
+	__atomic_store_n(_sqTail, tail, __ATOMIC_RELEASE);
+
+	// Once io_uring_enter fails, the reads it did not submit are taken back off the ring and
+	// only those in flight are waited for, so none completes later into a buffer a pread is
+	// filling, or among the next batch's completions. If waiting fails too, the ring is closed.
+	unsigned submit = static_cast<unsigned>(count);
+	size_t reaped = 0;
+	bool failed = false;
+	while (reaped < count - (failed ? submit : 0)) {
+		++ProcFile::_syscalls;
+		unsigned wait = static_cast<unsigned>(count - reaped) - (failed ? submit : 0);
+		long submitted = syscall(__NR_io_uring_enter, _ringFd, failed ? 0 : submit, wait,
+		                         IORING_ENTER_GETEVENTS, nullptr, 0);
+		int error = submitted < 0 ? errno : 0;
+		if (submitted > 0) {
+			submit -= static_cast<unsigned>(submitted);
+		}
+		unsigned head = *_cqHead;
+		unsigned cqTail = __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE);
+		auto now = chrono::steady_clock::now();
+		for (; head != cqTail; ++head, ++reaped) {
+			const io_uring_cqe &cqe = static_cast<io_uring_cqe*>(_cqes)[head & *_cqMask];
+			ProcFile &file = *_files[cqe.user_data];
+			if (cqe.res >= 0 && static_cast<size_t>(cqe.res) < file._buf.size() - 1) {
+				file._buf[cqe.res] = '\0';
+				file._ready = cqe.res;
+				file._readTime = now;
+			}
+		}
+		__atomic_store_n(_cqHead, head, __ATOMIC_RELEASE);
+
+		if (error && error != EINTR) {
+			if (failed) {
+				cout << "io_uring failed (" << strerror(error) << "), reading procfs with pread" << endl;
+				close_ring();
+				return;
+			}
+			failed = true;
+			__atomic_store_n(_sqTail, *_sqTail - submit, __ATOMIC_RELEASE);
+		}
+	}
+}
+
+#endif
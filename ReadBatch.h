@@ -0,0 +1,51 @@
+#ifndef __ReadBatch_h__
+#define __ReadBatch_h__
+
+#include <vector>
+
+#include "ProcFile.h"
+
+using namespace std;
+
+// Reads a set of ProcFiles together with io_uring: every read is submitted and reaped in
+// one io_uring_enter, instead of a pread each. The parsers then call read() as usual and
+// get the batched result without a syscall.
+//
+// Without io_uring (an old kernel, a seccomp filter, or kernel.io_uring_disabled) read()
+// does nothing and each file is pread when it is parsed, as before.
+class ReadBatch {
+	int _ringFd = -1;
+	unsigned _entries = 0;
+	// Submission and completion rings and the submission entries, mapped from the kernel
+	void* _sqRing = nullptr;
+	void* _cqRing = nullptr;
+	void* _sqes = nullptr;
+	size_t _sqRingSize = 0, _cqRingSize = 0, _sqesSize = 0;
+	unsigned *_sqTail = nullptr, *_sqMask = nullptr, *_sqArray = nullptr;
+	unsigned *_cqHead = nullptr, *_cqTail = nullptr, *_cqMask = nullptr;
+	void* _cqes = nullptr;
+
+	vector<ProcFile*> _files;
+
+	bool setup(unsigned entries);
+	void close_ring();
+	void read_chunk(size_t first, size_t count);
+
+  public:
+	// With useIoUring false, or if the ring can not be set up, reads fall back to pread
+	ReadBatch(bool useIoUring, unsigned entries = 16);
+	ReadBatch(const ReadBatch &) = delete;
+	ReadBatch& operator=(const ReadBatch &) = delete;
+	~ReadBatch();
+	bool uses_io_uring() const;
+
+	// Queues a file for the next read()
+	void add(ProcFile &file);
+	// Reads every queued file
+	void read();
+	// Forgets the queue and any batched result no parser used, so a later read() of
+	// those files reads them afresh
+	void clear();
+};
+
+#endif
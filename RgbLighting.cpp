@@ -1,15 +1,17 @@
 #include <iostream>
 #include <iomanip>
 #include <math.h>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
 #include "RgbLighting.h"
+#include "Trace.h"
 
 using namespace std;
 
 struct DevInfoType {
-	string deviceName;
+	CorsairDeviceType deviceType;
 	int ledCount;
 	int ledStartIndex;
 };
@@ -17,28 +19,35 @@ struct DevInfoType {
 // Maps logical devices to physical iCUE indicies
 static const unordered_map<string, vector<DevInfoType>> devInfo = {
 	{ "gpu", {
-				{"CommanderPro", 16,  0}
+				{CDT_CommanderPro, 16,  0}
 	}},
 	{ "reservoir", {
-				{"CommanderPro", 10, 16}
+				{CDT_CommanderPro, 10, 16}
 	}},
 	{ "cpu", {
-				{"CommanderPro", 16, 26}
+				{CDT_CommanderPro, 16, 26}
 	}},
 	{ "fan", { 
-				{"CommanderPro", 4, 42},
-				{"CommanderPro", 4, 50},
-				{"CommanderPro", 4, 46}
+				{CDT_CommanderPro, 4, 42},
+				{CDT_CommanderPro, 4, 50},
+				{CDT_CommanderPro, 4, 46}
 	}},
 	{ "ram", {
-				{"MemoryModule", 10, 0}
+				{CDT_MemoryModule, 10, 0}
 	}}
 };
 
-static const char* DeviceTypeStrings[] = { "Unknown", "Mouse", "Keyboard", "Headset", 
+// Devices come and go with USB hotplug and iCUE restarts, which renumbers the ones after
+static const chrono::seconds deviceCheckPeriod(2);
+
+static const char* DeviceTypeStrings[deviceTypeCount] = { "Unknown", "Mouse", "Keyboard", "Headset", 
                                            "MouseMat", "HeadsetStand", "CommanderPro",
                                            "LightingNodePro", "MemoryModule", "Cooler" };
 
+const char* device_type_name(CorsairDeviceType type) {
+	return type >= 0 && type < deviceTypeCount ? DeviceTypeStrings[type] : DeviceTypeStrings[CDT_Unknown];
+}
+
 //
 // Public methods
 //
@@ -59,7 +68,7 @@ void RgbLighting::print_device_info() {
     cout << "Found " << size << " devices" << endl;
 	for (int deviceIdx = 0; deviceIdx < size; ++deviceIdx) {
         auto deviceInfo = CorsairGetDeviceInfo(deviceIdx);
-        cout << "  Device ID " << deviceIdx << " is a " << DeviceTypeStrings[deviceInfo->type]
+        cout << "  Device ID " << deviceIdx << " is a " << device_type_name(deviceInfo->type)
              << " with " << deviceInfo->ledsCount << " LEDs" << endl;
 		if (const auto ledPositions = CorsairGetLedPositionsByDeviceIndex(deviceIdx)) {
 			for (auto i = 0; i < ledPositions->numberOfLed; i++) {
@@ -71,107 +80,155 @@ void RgbLighting::print_device_info() {
     cout << endl;
 }
 
-// Apparently the devices don't always have the same mapping (upon driver updates?), so figure out which is the commander
-// RAM sticks always seem to be in the correct order, though, so assume that
-std::unordered_map<string, int> RgbLighting::get_device_mapping() {
-   	auto deviceMap = std::unordered_map<string, int>();
-	int ramNumber = 1;
-    int size = CorsairGetDeviceCount();
+// Apparently the devices don't always have the same mapping (upon driver updates?), so devices are
+// found by type rather than by index
+const DeviceRegistry &RgbLighting::get_device_registry() {
+	if (!refresh_devices() && _listed) {
+		return _devices;
+	}
+	_listed = true;
+	int size = static_cast<int>(_devices.types.size());
     cout << "Found " << size << " devices" << endl;
 	for (int deviceIdx = 0; deviceIdx < size; ++deviceIdx) {
-        auto deviceInfo = CorsairGetDeviceInfo(deviceIdx);
-		std::string deviceName(DeviceTypeStrings[deviceInfo->type]);
-        cout << "  Device ID " << deviceIdx << " is a " << deviceName
-             << " with " << deviceInfo->ledsCount << " LEDs" << endl;
-		if (deviceName.compare("CommanderPro") == 0) {
-			deviceMap.insert({DeviceTypeStrings[deviceInfo->type], deviceIdx});
-		}
-		else if (deviceName.compare("MemoryModule") == 0) {
-			if (deviceMap.count("MemoryModule") == 0) {
-				deviceMap.insert({"MemoryModule", deviceIdx});
-				deviceMap.insert({"MemoryModuleCount", 1});
-			}
-			else {
-				deviceMap.insert({"MemoryModuleCount", deviceMap["MemoryModuleCount"] + 1});
-			}
-		}
-		else {
-			cout << "Ignoring unrecognized device string: " << deviceName << endl;
-		}
+        cout << "  Device ID " << deviceIdx << " is a " << device_type_name(_devices.types[deviceIdx])
+             << " with " << _devices.ledCounts[deviceIdx] << " LEDs" << endl;
 	}
     cout << endl;
-	return deviceMap;
+	return _devices;
 }
 
-LedMap RgbLighting::get_led_arrays()
+void RgbLighting::get_led_arrays(LedMap &ledMap)
 {
-	LedMap ledMap;
-	for (auto deviceIndex = 0; deviceIndex < CorsairGetDeviceCount(); deviceIndex++) {
-		if (const auto ledPositions = CorsairGetLedPositionsByDeviceIndex(deviceIndex)) {
-			vector<CorsairLedColor> leds;
-			for (auto i = 0; i < ledPositions->numberOfLed; i++) {
-				const auto ledId = ledPositions->pLedPosition[i].ledId;
-				leds.push_back(CorsairLedColor{ ledId, 0, 0, 0 });
+	// Entries of devices that went away are dropped
+	int count = static_cast<int>(_devices.types.size());
+	ledMap.resize(count);
+	for (auto deviceIndex = 0; deviceIndex < count; deviceIndex++) {
+		// A map that has not seen the device yet is built too
+		auto &leds = ledMap[deviceIndex];
+		const auto &positions = _devices.positions[deviceIndex];
+		if (!_stale[deviceIndex] && leds.size() == positions.size()) {
+			for (auto &led : leds) {
+				led.r = led.g = led.b = 0;
 			}
-			ledMap[deviceIndex] = leds;
+			continue;
+		}
+		// clear() keeps the capacity, so a device only allocates when it is new
+		leds.clear();
+		for (const auto &position : positions) {
+			leds.push_back(CorsairLedColor{ position.ledId, 0, 0, 0 });
 		}
+		_stale[deviceIndex] = 0;
 	}
-	return ledMap;
 }
 
-// Load colors to show the binary representation of number
-void RgbLighting::load_device_colors_binary(string devName, int devIndex, int controllerIndex, unsigned int number,
-                                            LedMap &ledMap, Color one, Color zero) {
-	DevInfoType dev = devInfo.at(devName)[devIndex];
-	if (number >= pow(2, dev.ledCount)) {
-		cout << "Can't represent " << number << " with only " << dev.ledCount << " LEDs!";
-		return;
+bool RgbLighting::check_devices(chrono::steady_clock::time_point now) {
+	if (now < _nextCheck) {
+		return false;
 	}
-	for (int i = 0; i < dev.ledCount; ++i) {
-		if ((number >> (dev.ledCount - 1 - i)) & 0x00000001) {   // Isolate bit and test if it should be lit
-			ledMap[controllerIndex][dev.ledStartIndex + i].r = one.r;
-			ledMap[controllerIndex][dev.ledStartIndex + i].g = one.g;
-			ledMap[controllerIndex][dev.ledStartIndex + i].b = one.b;
+	_nextCheck = now + deviceCheckPeriod;
+	_changed.clear();
+	return refresh_devices();
+}
+
+const vector<int> &RgbLighting::changed_devices() const {
+	return _changed;
+}
+
+LedStrip RgbLighting::make_strip(const string &devName, int devIndex, const vector<int> &controllerIndices) {
+	const DevInfoType &dev = devInfo.at(devName)[devIndex];
+	LedStrip strip;
+	for (int controllerIndex : controllerIndices) {
+		if (controllerIndex < 0 || controllerIndex >= static_cast<int>(_devices.types.size())
+		    || _devices.types[controllerIndex] != dev.deviceType) {
+			continue;
 		}
-		else {
-			ledMap[controllerIndex][dev.ledStartIndex + i].r = zero.r;
-			ledMap[controllerIndex][dev.ledStartIndex + i].g = zero.g;
-			ledMap[controllerIndex][dev.ledStartIndex + i].b = zero.b;
+		int ledCount = static_cast<int>(_devices.positions[controllerIndex].size());
+		for (int i = dev.ledStartIndex; i < dev.ledStartIndex + dev.ledCount && i < ledCount; ++i) {
+			strip.push_back(StripLed{ controllerIndex, i });
 		}
 	}
+	return strip;
 }
 
-void RgbLighting::load_device_colors_activity(string devName, int devIndex, int controllerIndex, int percentFull,
-                                              LedMap &ledMap, Color base, Color active) {
-	DevInfoType dev = devInfo.at(devName)[devIndex];
-	int threshold = percentFull * dev.ledCount / 100;
-	for (int i = dev.ledStartIndex; i < dev.ledStartIndex + dev.ledCount; ++i) {
-		if (i - dev.ledStartIndex <= threshold) {
-			ledMap[controllerIndex][i].r = active.r;
-			ledMap[controllerIndex][i].g = active.g;
-			ledMap[controllerIndex][i].b = active.b;
-		}
-		else {
-			ledMap[controllerIndex][i].r = base.r;
-			ledMap[controllerIndex][i].g = base.g;
-			ledMap[controllerIndex][i].b = base.b;
+// The LedMap entry of the device being drawn, looked up again only when the strip moves
+// on to the next device rather than for every LED
+struct DeviceCursor {
+	int device = -1;
+	vector<CorsairLedColor>* leds = nullptr;
+};
+
+// Strips are built for the devices of the latest check, but are still bounds checked in
+// case a device changed since
+static void set_led(LedMap &ledMap, DeviceCursor &cursor, const StripLed &led, Color color) {
+	if (led.device != cursor.device) {
+		cursor.device = led.device;
+		cursor.leds = static_cast<size_t>(led.device) < ledMap.size() ? &ledMap[led.device] : nullptr;
+	}
+	if (!cursor.leds || static_cast<size_t>(led.index) >= cursor.leds->size()) {
+		return;
+	}
+	CorsairLedColor &target = (*cursor.leds)[led.index];
+	target.r = color.r;
+	target.g = color.g;
+	target.b = color.b;
+}
+
+// Load colors to show the binary representation of number
+void RgbLighting::load_device_colors_binary(const LedStrip &strip, unsigned int number, LedMap &ledMap,
+                                            Color one, Color zero) {
+	int ledCount = static_cast<int>(strip.size());
+	if (number >= pow(2, ledCount)) {
+		cout << "Can't represent " << number << " with only " << ledCount << " LEDs!";
+		return;
+	}
+	DeviceCursor cursor;
+	for (int i = 0; i < ledCount; ++i) {
+		// Isolate bit and test if it should be lit
+		set_led(ledMap, cursor, strip[i], (number >> (ledCount - 1 - i)) & 0x00000001 ? one : zero);
+	}
+}
+
+void RgbLighting::load_device_colors_activity(const LedStrip &strip, int percentFull, LedMap &ledMap,
+                                              Color base, Color active) {
+	int threshold = percentFull * static_cast<int>(strip.size()) / 100;
+	DeviceCursor cursor;
+	for (int i = 0; i < static_cast<int>(strip.size()); ++i) {
+		set_led(ledMap, cursor, strip[i], i <= threshold ? active : base);
+	}
+}
+
+// Fills the strip with layers stacked end to end, in one pass over its LEDs. tops holds
+// where each layer ends, as running totals in ascending order, and the strip shows the
+// part of the stack from rangeMin to rangeMax. Each LED takes the color of the layer at its
+// middle, or base past the last layer.
+void RgbLighting::load_device_colors_stacked(const LedStrip &strip, const float* tops, const Color* colors,
+                                             int layers, float rangeMin, float rangeMax, LedMap &ledMap, Color base) {
+	float step = (rangeMax - rangeMin) / strip.size();
+	int layer = 0;
+	DeviceCursor cursor;
+	for (size_t i = 0; i < strip.size(); ++i) {
+		float position = rangeMin + (i + 0.5f) * step;
+		while (layer < layers && position >= tops[layer]) {
+			++layer;
 		}
+		set_led(ledMap, cursor, strip[i], layer < layers ? colors[layer] : base);
 	}
 }
 
-void RgbLighting::load_device_colors_static(string devName, int devIndex, int controllerIndex, LedMap &ledMap, Color base) {
-	DevInfoType dev = devInfo.at(devName)[devIndex];
-	for (int i = dev.ledStartIndex; i < dev.ledStartIndex + dev.ledCount; ++i) {
-		ledMap[controllerIndex][i].r = base.r;
-		ledMap[controllerIndex][i].g = base.g;
-		ledMap[controllerIndex][i].b = base.b;
+void RgbLighting::load_device_colors_static(const LedStrip &strip, LedMap &ledMap, Color base) {
+	DeviceCursor cursor;
+	for (const auto &led : strip) {
+		set_led(ledMap, cursor, led, base);
 	}
 }
 
-void RgbLighting::set_colors(LedMap ledMap) {
-	for (auto leds : ledMap) {
-		auto deviceIdx = leds.first;
-		auto ledsVec = leds.second;
+void RgbLighting::set_colors(LedMap &ledMap) {
+	TRACE_SCOPE("flush (corsair)");
+	for (int deviceIdx = 0; deviceIdx < static_cast<int>(ledMap.size()); ++deviceIdx) {
+		auto &ledsVec = ledMap[deviceIdx];
+		if (ledsVec.empty()) {
+			continue;
+		}
 		if (!CorsairSetLedsColorsBufferByDeviceIndex(deviceIdx, ledsVec.size(), ledsVec.data())) {
 			report_error("setting DRAM LEDs");
 		}
@@ -185,7 +242,59 @@ void RgbLighting::set_colors(LedMap ledMap) {
 // Private methods
 //
 
-void RgbLighting::report_error(string errorString) {
+// Reads the type and LED count of every device, and marks the slots where they differ
+// from the previous read, or that are new or gone, as changed. Only those slots have their
+// LED positions read again.
+bool RgbLighting::refresh_devices() {
+	int count = CorsairGetDeviceCount();
+	_scan.resize(max(count, 0));
+	for (int deviceIdx = 0; deviceIdx < count; ++deviceIdx) {
+		auto deviceInfo = CorsairGetDeviceInfo(deviceIdx);
+		bool known = deviceInfo && deviceInfo->type >= 0 && deviceInfo->type < deviceTypeCount;
+		_scan[deviceIdx] = DeviceFingerprint{ known ? deviceInfo->type : CDT_Unknown,
+		                                      deviceInfo ? deviceInfo->ledsCount : 0 };
+	}
+	size_t before = _devices.types.size();
+	size_t slots = max(_scan.size(), before);
+	size_t firstChange = _changed.size();
+	for (size_t slot = 0; slot < slots; ++slot) {
+		if (slot >= _scan.size() || slot >= before || _scan[slot].type != _devices.types[slot]
+		    || _scan[slot].ledsCount != _devices.ledCounts[slot]) {
+			_changed.push_back(static_cast<int>(slot));
+		}
+	}
+	if (_changed.size() == firstChange) {
+		return false;
+	}
+
+	_devices.types.resize(_scan.size());
+	_devices.ledCounts.resize(_scan.size());
+	_devices.positions.resize(_scan.size());
+	_stale.resize(_scan.size());
+	for (size_t change = firstChange; change < _changed.size(); ++change) {
+		int slot = _changed[change];
+		if (slot >= count) {
+			continue;
+		}
+		_devices.types[slot] = _scan[slot].type;
+		_devices.ledCounts[slot] = _scan[slot].ledsCount;
+		auto &positions = _devices.positions[slot];
+		positions.clear();
+		if (const auto ledPositions = CorsairGetLedPositionsByDeviceIndex(slot)) {
+			positions.assign(ledPositions->pLedPosition, ledPositions->pLedPosition + ledPositions->numberOfLed);
+		}
+		_stale[slot] = 1;
+	}
+	for (auto &devices : _devices.byType) {
+		devices.clear();
+	}
+	for (int slot = 0; slot < count; ++slot) {
+		_devices.byType[_devices.types[slot]].push_back(slot);
+	}
+	return true;
+}
+
+void RgbLighting::report_error(const char* errorString) {
 	CorsairError error = CorsairGetLastError();
 	cout << "Corsair error while " << errorString << ": " << error << endl;
 }
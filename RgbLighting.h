@@ -1,8 +1,9 @@
 #ifndef __RgbLighting_h__
 #define __RgbLighting_h__
 
+#include <array>
+#include <chrono>
 #include <string>
-#include <unordered_map>
 #include <vector>
 
 // iCUE API for controlling lighting
@@ -10,27 +11,81 @@
 
 using namespace std;
 
-using LedMap = unordered_map<int, vector<CorsairLedColor>>;
+// The colors of every LED, by SDK device index
+using LedMap = vector<vector<CorsairLedColor>>;
 struct Color  {
 	int r;
 	int g;
 	int b;
 };
 
+// One LED of a strip: the device it is on and its index in the device's LedMap entry
+struct StripLed {
+	int device;
+	int index;
+};
+// The LEDs of a devInfo segment on one or more devices, end to end as one bar, such as
+// the same segment on every RAM stick. make_strip() works the table out once, so drawing
+// a strip is a single pass over it whatever devices it spans.
+using LedStrip = vector<StripLed>;
+
+// Device types up to CDT_Cooler. Types added to the SDK after it count as CDT_Unknown.
+const int deviceTypeCount = CDT_Cooler + 1;
+const char* device_type_name(CorsairDeviceType type);
+
+// The attached devices, as the latest check found them. Everything is by SDK device index
+// or by type, so finding a device or its LEDs is an array index.
+struct DeviceRegistry {
+	// Device indices of each type in SDK order, so the second RAM stick is
+	// byType[CDT_MemoryModule][1] wherever it is numbered
+	array<vector<int>, deviceTypeCount> byType;
+	// By device index
+	vector<CorsairDeviceType> types;
+	vector<int> ledCounts;
+	vector<vector<CorsairLedPosition>> positions;
+};
+
 class RgbLighting {
-	void report_error(string errorString);
+	// What identifies the device in a slot, cheap enough to compare every few seconds
+	struct DeviceFingerprint {
+		CorsairDeviceType type;
+		int ledsCount;
+	};
+	DeviceRegistry _devices;
+	vector<DeviceFingerprint> _scan;
+	// Slots whose LedMap entry has to be built again from their LED positions
+	vector<char> _stale;
+	vector<int> _changed;
+	chrono::steady_clock::time_point _nextCheck;
+	// Whether get_device_registry() has printed the devices yet
+	bool _listed = false;
+
+	bool refresh_devices();
+	void report_error(const char* errorString);
 	const char* toString(CorsairError error);
   public:
   	RgbLighting();
 	void print_device_info();
-	LedMap get_led_arrays();
-	std::unordered_map<string, int> get_device_mapping();
-	void load_device_colors_binary(string devName, int devIndex, int controllerIndex, unsigned int number,
-	                               LedMap& ledMap, Color one, Color zero);
-	void load_device_colors_activity(string devName, int devIndex, int controllerIndex, int percentFull,
-	                                 LedMap &ledMap, Color base, Color active);
-    void load_device_colors_static(string devName, int devIndex, int controllerIndex, LedMap &ledMap, Color base);
-	void set_colors(LedMap ledMap);
+	// Clears ledMap's colors in place. Only slots whose device changed are built again,
+	// so it only allocates when it first sees a device.
+	void get_led_arrays(LedMap &ledMap);
+	// Returns the attached devices, listing them on the first call and when they changed.
+	// The registry is updated in place by later checks.
+	const DeviceRegistry &get_device_registry();
+	// Every few seconds, compares the attached devices with those of the previous check
+	// and returns whether any slot changed. changed_devices() then lists the slots, and
+	// get_device_registry() gives where each device now is.
+	bool check_devices(chrono::steady_clock::time_point now);
+	const vector<int> &changed_devices() const;
+	// Segment devIndex of devName on each of controllerIndices in turn. LEDs past the end
+	// of a device, or on a device that is not there or of another type, are left out.
+	LedStrip make_strip(const string &devName, int devIndex, const vector<int> &controllerIndices);
+	void load_device_colors_binary(const LedStrip &strip, unsigned int number, LedMap& ledMap, Color one, Color zero);
+	void load_device_colors_activity(const LedStrip &strip, int percentFull, LedMap &ledMap, Color base, Color active);
+	void load_device_colors_stacked(const LedStrip &strip, const float* tops, const Color* colors, int layers,
+	                                float rangeMin, float rangeMax, LedMap &ledMap, Color base);
+    void load_device_colors_static(const LedStrip &strip, LedMap &ledMap, Color base);
+	void set_colors(LedMap &ledMap);
 };
 
 #endif
@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#ifdef _WIN32
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "SelfActivity.h"
+
+using namespace std;
+
+SelfActivity::SelfActivity() {
+	_cpuCount = max(1u, thread::hardware_concurrency());
+#ifndef _WIN32
+	_pageSize = sysconf(_SC_PAGESIZE);
+	if (!_statm.is_open()) {
+		cout << "Opening /proc/self/statm failed, own RSS will read as 0" << endl;
+	}
+#endif
+}
+
+void SelfActivity::sample() {
+	long long cpuNs = process_cpu_ns();
+	_clock.advance(chrono::steady_clock::now());
+	long long contextSwitches = context_switch_count();
+
+	// The first sample only sets the baseline, startup work is not worth reporting
+	if (_clock.ready()) {
+		// Nanoseconds of CPU per second, so 1e9 is one CPU kept busy
+		_cpuLoad = static_cast<float>(100 * _clock.rate(cpuNs, _previousCpuNs) / (1e9 * _cpuCount));
+		_contextSwitches = counter_delta(contextSwitches, _previousContextSwitches);
+	}
+	_rssBytes = resident_bytes();
+
+	_previousCpuNs = cpuNs;
+	_previousContextSwitches = contextSwitches;
+}
+
+float SelfActivity::get_cpu_load() {
+	return _cpuLoad;
+}
+
+long long SelfActivity::get_context_switches() {
+	return _contextSwitches;
+}
+
+long long SelfActivity::get_rss_bytes() {
+	return _rssBytes;
+}
+
+vector<MetricInfo> SelfActivity::metrics() {
+	return { {"self.cpu", "%", 2}, {"self.context_switches", " csw", 0}, {"self.rss", " MiB", 1} };
+}
+
+int SelfActivity::sample_cost_us() {
+	return 5;
+}
+
+void SelfActivity::sample(float* values) {
+	sample();
+	values[0] = _cpuLoad;
+	values[1] = static_cast<float>(_contextSwitches);
+	values[2] = _rssBytes / (1024.0f * 1024.0f);
+}
+
+//
+// Private methods
+//
+
+#ifdef _WIN32
+static long long file_time_to_ns(const FILETIME &ft) {
+	return static_cast<long long>((((unsigned long long)(ft.dwHighDateTime))<<32)|((unsigned long long)ft.dwLowDateTime)) * 100;
+}
+
+long long SelfActivity::process_cpu_ns() {
+	FILETIME creationTime, exitTime, kernelTime, userTime;
+	if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime)) {
+		return _previousCpuNs;
+	}
+	return file_time_to_ns(kernelTime) + file_time_to_ns(userTime);
+}
+
+// Windows keeps switch counts per thread only, behind performance counters, so none are reported
+long long SelfActivity::context_switch_count() {
+	return 0;
+}
+
+long long SelfActivity::resident_bytes() {
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return 0;
+	}
+	return static_cast<long long>(counters.WorkingSetSize);
+}
+#else
+static long long timespec_ns(clockid_t clock) {
+	struct timespec ts;
+	if (clock_gettime(clock, &ts) != 0) {
+		return 0;
+	}
+	return static_cast<long long>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+long long SelfActivity::process_cpu_ns() {
+	return timespec_ns(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+long long SelfActivity::context_switch_count() {
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) {
+		return _previousContextSwitches;
+	}
+	return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+// /proc/self/statm is "size resident shared text lib data dt", in pages
+long long SelfActivity::resident_bytes() {
+	const char *pos = _statm.read();
+	if (!pos) {
+		return 0;
+	}
+	parse_uint(pos);
+	return static_cast<long long>(parse_uint(pos)) * _pageSize;
+}
+#endif
@@ -0,0 +1,49 @@
+#ifndef __SelfActivity_h__
+#define __SelfActivity_h__
+
+#ifdef _WIN32
+#include "windows.h"
+#endif
+
+#include "MetricSource.h"
+#include "ProcFile.h"
+#include "Rate.h"
+
+using namespace std;
+
+// Resource usage of this process, to show the monitor is not itself the load
+class SelfActivity : public MetricSource {
+	// Process CPU time at the previous sample, in nanoseconds, and when samples were taken
+	long long _previousCpuNs = 0;
+	RateClock _clock;
+	long long _previousContextSwitches = 0;
+	int _cpuCount = 1;
+
+	float _cpuLoad = 0;
+	long long _contextSwitches = 0;
+	long long _rssBytes = 0;
+
+#ifndef _WIN32
+	ProcFile _statm{"/proc/self/statm", 128};
+	long _pageSize = 4096;
+#endif
+
+	long long process_cpu_ns();
+	long long context_switch_count();
+	long long resident_bytes();
+
+  public:
+	SelfActivity();
+	// Takes a new reading, the getters report the interval since the previous one
+	void sample();
+	// Share of the whole machine's CPU capacity, comparable to ComputerActivity::get_cpu_load()
+	float get_cpu_load();
+	long long get_context_switches();
+	long long get_rss_bytes();
+
+	vector<MetricInfo> metrics() override;
+	int sample_cost_us() override;
+	void sample(float* values) override;
+};
+
+#endif
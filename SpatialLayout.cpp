@@ -0,0 +1,203 @@
+#include <iostream>
+#include <math.h>
+
+#include "SpatialLayout.h"
+#include "Trace.h"
+
+using namespace std;
+
+// Frame rate while a ripple spreads or the fill is still moving
+static const chrono::milliseconds spatialFramePeriod(33);
+static const chrono::duration<float> rippleDuration(1.5f);
+// Ripples past this many at once replace the oldest
+static const size_t maxRipples = 8;
+// In device units, where each device is 1 across and 1 high. Rings reach the corners as they fade.
+static const float rippleWidth = 0.12f;
+static const float rippleReach = 0.71f;
+// Height of the soft top edge of the fill, and how long it takes to catch up with most of
+// a change of the metric
+static const float fillEdge = 0.1f;
+static const chrono::duration<float> fillEase(0.25f);
+// LEDs are evaluated in blocks of this many, the arrays padded to whole blocks, so the loop
+// over a block has a fixed length and is vectorized even by -O2, which will not add a
+// scalar loop for the LEDs left over
+static const int ledBlock = 8;
+
+// t clamped to [0, 1], and t or 0 if it is negative. Written with fabsf(), as -O2 keeps a
+// ?: on floats as a branch, which stops the loop around it being vectorized.
+static inline float clamp_unit(float t) {
+	return 0.5f * (fabsf(t) - fabsf(t - 1) + 1);
+}
+
+static inline float positive(float t) {
+	return 0.5f * (t + fabsf(t));
+}
+
+// Each effect is one pass over every LED without branches. The arrays never overlap, and
+// saying so spares the loop a check for it.
+static void fill_leds(float* __restrict r, float* __restrict g, float* __restrict b, const float* __restrict y,
+                      int padded, float top, Color on, Color off) {
+	float onR = on.r, onG = on.g, onB = on.b;
+	float offR = off.r, offG = off.g, offB = off.b;
+	for (int block = 0; block < padded; block += ledBlock) {
+		for (int i = block; i < block + ledBlock; ++i) {
+			float t = clamp_unit((top - y[i]) / fillEdge);
+			r[i] = offR + (onR - offR) * t;
+			g[i] = offG + (onG - offG) * t;
+			b[i] = offB + (onB - offB) * t;
+		}
+	}
+}
+
+// Blends color over the LEDs within rippleWidth of radius from the middle of each device
+static void add_ripple(float* __restrict r, float* __restrict g, float* __restrict b,
+                       const float* __restrict distance, int padded, float radius, float strength, Color color) {
+	float colorR = color.r, colorG = color.g, colorB = color.b;
+	for (int block = 0; block < padded; block += ledBlock) {
+		for (int i = block; i < block + ledBlock; ++i) {
+			float t = positive(1 - fabsf(distance[i] - radius) / rippleWidth) * strength;
+			r[i] += (colorR - r[i]) * t;
+			g[i] += (colorG - g[i]) * t;
+			b[i] += (colorB - b[i]) * t;
+		}
+	}
+}
+
+// The effects of --spatial. The first fill row whose metric exists is used.
+static const SpatialBinding spatial[] = {
+	// CPU load rises through the case
+	{ SE_Fill,   "cpu.load",   0, 100, &Theme::cpu_active, &Theme::cpu_base },
+
+	// Sudden load sends a ring out from the middle
+	{ SE_Ripple, "cpu.load",  25,   0, &Theme::alert,      &Theme::alert },
+	{ SE_Ripple, "gpu.load",  25,   0, &Theme::gpu_active, &Theme::gpu_active },
+	{ SE_Ripple, "disk.util", 40,   0, &Theme::cpu_iowait, &Theme::cpu_iowait },
+};
+
+SpatialLayout::SpatialLayout(RgbLighting* lighting, const DeviceRegistry &devices, const MetricRegistry &registry,
+                             const Theme &theme) : _lighting(lighting), _fill{ -1, 0, 1, {}, {}, 0 } {
+	place_leds(devices);
+	bool filled = false;
+	for (const auto &binding : spatial) {
+		MetricId metric = registry.find(binding.metric);
+		ResolvedSpatial resolved{ metric, binding.rangeMin, binding.rangeMax, theme.*binding.on, theme.*binding.off,
+		                          registry.value(metric) };
+		if (binding.effect == SE_Fill && !filled) {
+			// Without a metric the rig stays empty, rather than dark
+			_fill = resolved;
+			filled = metric >= 0;
+		}
+		if (metric < 0) {
+			cout << "No metric " << binding.metric << " for spatial effect" << endl;
+			continue;
+		}
+		if (binding.effect == SE_Ripple) {
+			_ripples.push_back(resolved);
+		}
+	}
+	// Reserved up front, so starting a ripple in a frame does not allocate
+	_active.reserve(maxRipples);
+}
+
+void SpatialLayout::update_devices(const DeviceRegistry &devices) {
+	place_leds(devices);
+}
+
+chrono::steady_clock::time_point SpatialLayout::next_frame() const {
+	if (_active.empty() && fabsf(_level - _target) < 0.005f) {
+		return chrono::steady_clock::time_point::max();
+	}
+	return _lastFrame + spatialFramePeriod;
+}
+
+void SpatialLayout::render(const MetricRegistry &registry, chrono::steady_clock::time_point now, LedMap &ledMap) {
+	TRACE_SCOPE("render (spatial)");
+	_lighting->get_led_arrays(ledMap);
+	float seconds = _lastFrame == chrono::steady_clock::time_point() ? 0
+	              : chrono::duration<float>(now - _lastFrame).count();
+	_lastFrame = now;
+
+	float share = (registry.value(_fill.metric) - _fill.rangeMin) / (_fill.rangeMax - _fill.rangeMin);
+	_target = min(max(share, 0.0f), 1.0f);
+	_level = seconds > 0 ? _level + (_target - _level) * min(seconds / fillEase.count(), 1.0f) : _target;
+
+	for (auto &ripple : _ripples) {
+		float value = registry.value(ripple.metric);
+		if (value - ripple.previous >= ripple.rangeMin) {
+			if (_active.size() == maxRipples) {
+				_active.erase(_active.begin());
+			}
+			_active.push_back(Ripple{ now, ripple.on });
+		}
+		ripple.previous = value;
+	}
+	while (!_active.empty() && now - _active.front().start >= rippleDuration) {
+		_active.erase(_active.begin());
+	}
+
+	// The fill's top is past the top of each device when full, so the soft edge is gone
+	int padded = static_cast<int>(_y.size());
+	fill_leds(_r.data(), _g.data(), _b.data(), _y.data(), padded, _level * (1 + fillEdge), _fill.on, _fill.off);
+	for (const auto &ripple : _active) {
+		float age = chrono::duration<float>(now - ripple.start) / rippleDuration;
+		add_ripple(_r.data(), _g.data(), _b.data(), _distance.data(), padded, rippleReach * age, 1 - age, ripple.color);
+	}
+
+	int devices = min(static_cast<int>(ledMap.size()), static_cast<int>(_firstLed.size()) - 1);
+	for (int device = 0; device < devices; ++device) {
+		auto &colors = ledMap[device];
+		int first = _firstLed[device];
+		int count = min(static_cast<int>(colors.size()), _firstLed[device + 1] - first);
+		for (int i = 0; i < count; ++i) {
+			colors[i].r = static_cast<int>(_r[first + i] + 0.5f);
+			colors[i].g = static_cast<int>(_g[first + i] + 0.5f);
+			colors[i].b = static_cast<int>(_b[first + i] + 0.5f);
+		}
+	}
+}
+
+//
+// Private methods
+//
+
+// LED centers are scaled to the box around each device's LEDs. iCUE gives each device's
+// positions in its own millimetres, from its own corner, so the devices cannot be placed
+// against each other; each is scaled to 0 to 1 on its own, so it fills over its own height.
+void SpatialLayout::place_leds(const DeviceRegistry &devices) {
+	_x.clear();
+	_y.clear();
+	_firstLed.clear();
+	for (const auto &positions : devices.positions) {
+		_firstLed.push_back(static_cast<int>(_x.size()));
+		for (const auto &position : positions) {
+			_x.push_back(static_cast<float>(position.left + position.width / 2));
+			_y.push_back(static_cast<float>(position.top + position.height / 2));
+		}
+	}
+	_firstLed.push_back(static_cast<int>(_x.size()));
+
+	size_t leds = _x.size();
+	size_t padded = (leds + ledBlock - 1) / ledBlock * ledBlock;
+	_x.resize(padded);
+	_y.resize(padded);
+	_distance.resize(padded);
+	for (size_t device = 0; device + 1 < _firstLed.size(); ++device) {
+		int first = _firstLed[device], last = _firstLed[device + 1];
+		float minX = 0, maxX = 0, minY = 0, maxY = 0;
+		for (int i = first; i < last; ++i) {
+			minX = i > first ? min(minX, _x[i]) : _x[i];
+			maxX = i > first ? max(maxX, _x[i]) : _x[i];
+			minY = i > first ? min(minY, _y[i]) : _y[i];
+			maxY = i > first ? max(maxY, _y[i]) : _y[i];
+		}
+		for (int i = first; i < last; ++i) {
+			// A row or column of LEDs sits in the middle of its device, and SDK tops grow downwards
+			_x[i] = maxX > minX ? (_x[i] - minX) / (maxX - minX) : 0.5f;
+			_y[i] = maxY > minY ? 1 - (_y[i] - minY) / (maxY - minY) : 0.5f;
+			_distance[i] = hypotf(_x[i] - 0.5f, _y[i] - 0.5f);
+		}
+	}
+	_r.resize(padded);
+	_g.resize(padded);
+	_b.resize(padded);
+}
@@ -0,0 +1,72 @@
+#ifndef __SpatialLayout_h__
+#define __SpatialLayout_h__
+
+#include <chrono>
+#include <vector>
+
+#include "Layout.h"
+#include "MetricRegistry.h"
+#include "RgbLighting.h"
+
+using namespace std;
+
+enum SpatialEffect {
+	SE_Fill,        // each device fills from the bottom up to the metric's share of [rangeMin, rangeMax]
+	SE_Ripple       // a ring spreads out from the middle of each device when the metric jumps by rangeMin
+};
+
+// Binds one effect over the whole rig to a metric. As in the Layout table, the first fill
+// row whose metric exists is used, while every ripple row whose metric exists can fire.
+struct SpatialBinding {
+	SpatialEffect effect;
+	const char* metric;
+	float rangeMin, rangeMax;
+	Color Theme::*on;          // filled or ripple color, and empty color
+	Color Theme::*off;
+};
+
+// Renders effects that are functions of where each LED is, rather than of its place in a
+// segment, as described by the table in SpatialLayout.cpp. The LED positions from the SDK
+// are scaled to each device's box once into arrays of floats, one per coordinate, so a frame is a
+// few plain loops over every LED that the compiler vectorizes, then one copy into the
+// LedMap.
+class SpatialLayout {
+	struct Ripple {
+		chrono::steady_clock::time_point start;
+		Color color;
+	};
+	struct ResolvedSpatial {
+		MetricId metric;
+		float rangeMin, rangeMax;
+		Color on, off;
+		float previous;            // metric value at the previous frame, to see jumps
+	};
+	RgbLighting* _lighting;
+	// Every LED in device order, 0 to 1 across and up its device, and distance from its middle
+	vector<float> _x, _y, _distance;
+	// Index of each device's first LED in the arrays, by device index, and one past the last
+	vector<int> _firstLed;
+	// The frame's color of each LED
+	vector<float> _r, _g, _b;
+	ResolvedSpatial _fill;
+	vector<ResolvedSpatial> _ripples;
+	// Ripples still spreading, oldest first, at most maxRipples
+	vector<Ripple> _active;
+	// Fill level shown, easing towards the metric's so the fill moves smoothly between samples
+	float _level = 0, _target = 0;
+	chrono::steady_clock::time_point _lastFrame;
+
+	void place_leds(const DeviceRegistry &devices);
+
+  public:
+	SpatialLayout(RgbLighting* lighting, const DeviceRegistry &devices, const MetricRegistry &registry,
+	              const Theme &theme);
+	// Places the LEDs again, after RgbLighting::check_devices() found a change
+	void update_devices(const DeviceRegistry &devices);
+	// When the next frame is needed while an effect is moving, or time_point::max() when
+	// the LEDs only change with the metrics
+	chrono::steady_clock::time_point next_frame() const;
+	void render(const MetricRegistry &registry, chrono::steady_clock::time_point now, LedMap &ledMap);
+};
+
+#endif
@@ -0,0 +1,177 @@
+#include "Trace.h"
+
+#ifdef PC_ACTIVITY_TRACE
+
+#include <atomic>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static const int maxThreads = 64;
+static TraceThread* threads[maxThreads];
+static atomic<int> threadCount(0);
+static char dumpPath[512];
+
+// Clock readings taken at init, to convert ticks to nanoseconds at dump time
+static long long initTicks;
+static long long initNs;
+
+static long long steady_ns() {
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+thread_local TraceThread* traceThreadLocal = nullptr;
+thread_local bool traceThreadDropped = false;
+
+// Buffers are allocated once per thread, on its first event. Threads past maxThreads
+// get none, as they could not be dumped.
+TraceThread* trace_register_thread() {
+	int slot = threadCount.fetch_add(1);
+	if (slot >= maxThreads) {
+		traceThreadDropped = true;
+		return nullptr;
+	}
+	auto thread = new TraceThread;
+	thread->tid = slot + 1;
+	thread->count = 0;
+	threads[slot] = thread;
+	return thread;
+}
+
+//
+// The dump runs from signal handlers, so it formats by hand into a static buffer
+// and only uses write(2)
+//
+
+static char out[1 << 16];
+static int outLen = 0;
+static int outFd = -1;
+
+static void flush_out() {
+	if (outLen > 0 && outFd >= 0) {
+		(void)!write(outFd, out, outLen);
+	}
+	outLen = 0;
+}
+
+static void put_str(const char* str) {
+	while (*str) {
+		if (outLen == sizeof(out)) {
+			flush_out();
+		}
+		out[outLen++] = *str++;
+	}
+}
+
+static void put_int(long long value) {
+	char digits[24];
+	int n = 0;
+	bool negative = value < 0;
+	unsigned long long v = negative ? -(unsigned long long)value : value;
+	do {
+		digits[n++] = '0' + v % 10;
+		v /= 10;
+	} while (v);
+	char text[26];
+	int len = 0;
+	if (negative) {
+		text[len++] = '-';
+	}
+	while (n) {
+		text[len++] = digits[--n];
+	}
+	text[len] = '\0';
+	put_str(text);
+}
+
+// Trace timestamps are microseconds, keep nanosecond precision as decimals
+static void put_us(long long ns) {
+	if (ns < 0) {
+		ns = 0;
+	}
+	put_int(ns / 1000);
+	char frac[5] = { '.', (char)('0' + ns / 100 % 10), (char)('0' + ns / 10 % 10), (char)('0' + ns % 10), '\0' };
+	put_str(frac);
+}
+
+void trace_dump() {
+	outFd = open(dumpPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (outFd < 0) {
+		return;
+	}
+	double nsPerTick = 1.0;
+	long long ticks = trace_ticks() - initTicks;
+	if (ticks > 0) {
+		nsPerTick = static_cast<double>(steady_ns() - initNs) / ticks;
+	}
+	put_str("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	bool first = true;
+	int count = threadCount.load();
+	for (int t = 0; t < count && t < maxThreads; ++t) {
+		TraceThread* thread = threads[t];
+		if (!thread) {
+			continue;
+		}
+		unsigned long long end = thread->count;
+		unsigned long long begin = end > TraceThread::capacity ? end - TraceThread::capacity : 0;
+		for (auto i = begin; i < end; ++i) {
+			const TraceEvent &event = thread->events[i & (TraceThread::capacity - 1)];
+			put_str(first ? "" : ",\n");
+			put_str("{\"name\":\"");
+			put_str(event.name);
+			put_str("\",\"ph\":\"X\",\"pid\":1,\"tid\":");
+			put_int(thread->tid);
+			put_str(",\"ts\":");
+			put_us(static_cast<long long>((event.start - initTicks) * nsPerTick));
+			put_str(",\"dur\":");
+			put_us(static_cast<long long>(event.duration * nsPerTick));
+			put_str("}");
+			first = false;
+		}
+	}
+	put_str("\n],\"otherData\":{\"droppedThreads\":");
+	put_int(count > maxThreads ? count - maxThreads : 0);
+	put_str("}}\n");
+	flush_out();
+	close(outFd);
+	outFd = -1;
+}
+
+static void dump_on_signal(int sig) {
+	trace_dump();
+	signal(sig, dump_on_signal);
+}
+
+static void dump_and_exit(int sig) {
+	trace_dump();
+	signal(sig, SIG_DFL);
+	raise(sig);
+}
+
+static void dump_at_exit() {
+	trace_dump();
+}
+
+void trace_init(const char* path) {
+	strncpy(dumpPath, path, sizeof(dumpPath) - 1);
+	initTicks = trace_ticks();
+	initNs = steady_ns();
+	atexit(dump_at_exit);
+	signal(SIGINT, dump_and_exit);
+	signal(SIGTERM, dump_and_exit);
+#ifdef _WIN32
+	signal(SIGBREAK, dump_on_signal);
+#else
+	signal(SIGUSR1, dump_on_signal);
+#endif
+}
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef __Trace_h__
+#define __Trace_h__
+
+//
+// Pipeline stage tracing in Chrome trace-event format (load the dump in chrome://tracing
+// or Perfetto). Only compiled in when built with -DPC_ACTIVITY_TRACE, otherwise every
+// macro below expands to nothing.
+//
+//   TRACE_INIT("trace.json");   // once, at startup
+//   TRACE_SCOPE("render");      // times the enclosing block
+//
+// Events go into a preallocated ring buffer per thread, so recording is a clock read
+// and a few stores. The buffers are dumped at exit, on Ctrl-C, and on demand with
+// SIGUSR1 (Ctrl-Break on Windows). Threads past the first 64 record nothing, and the
+// dump counts them as droppedThreads.
+//
+
+#ifdef PC_ACTIVITY_TRACE
+
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Times are raw clock ticks, converted to nanoseconds when dumped
+struct TraceEvent {
+	const char* name;
+	long long start;
+	long long duration;
+};
+
+// Ring of the most recent events recorded by one thread
+struct TraceThread {
+	static const int capacity = 1 << 16;
+	int tid;
+	unsigned long long count;
+	TraceEvent events[capacity];
+};
+
+extern thread_local TraceThread* traceThreadLocal;
+// Set once a thread found the registry full, so it does not try again on every event
+extern thread_local bool traceThreadDropped;
+TraceThread* trace_register_thread();
+void trace_init(const char* path);
+void trace_dump();
+
+// nullptr for a thread that is not traced
+inline TraceThread* trace_thread() {
+	if (!traceThreadLocal && !traceThreadDropped) {
+		traceThreadLocal = trace_register_thread();
+	}
+	return traceThreadLocal;
+}
+
+// The TSC is several times cheaper to read than steady_clock, which keeps an event well under 50 ns
+inline long long trace_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+	return static_cast<long long>(__rdtsc());
+#else
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+class TraceScope {
+	const char* _name;
+	long long _start;
+  public:
+	TraceScope(const char* name) : _name(name), _start(trace_ticks()) {}
+	~TraceScope() {
+		TraceThread* thread = trace_thread();
+		if (!thread) {
+			return;
+		}
+		TraceEvent &event = thread->events[thread->count & (TraceThread::capacity - 1)];
+		event.name = _name;
+		event.start = _start;
+		event.duration = trace_ticks() - _start;
+		++thread->count;
+	}
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_INIT(path) trace_init(path)
+
+#else
+
+#define TRACE_SCOPE(name)
+#define TRACE_INIT(path)
+
+#endif
+
+#endif
@@ -0,0 +1,123 @@
+#include "VmstatActivity.h"
+
+#ifndef _WIN32
+
+#include <iostream>
+#include <string.h>
+
+using namespace std;
+
+// Paging moves in bursts that a 5 second average would flatten
+static const chrono::milliseconds samplePeriod(1000);
+
+enum Metric { M_Fault, M_MajorFault, M_SwapIn, M_SwapOut, M_Scan, M_Steal, M_Count };
+
+// The counters read, and the metric each one adds to. Scans and steals are split by who
+// did the reclaim; the _anon and _file counters split the same pages another way and
+// are left out so nothing is counted twice. Older kernels lack some of them.
+static const struct {
+	const char* name;
+	Metric metric;
+} keys[] = {
+	{ "pgfault",            M_Fault },
+	{ "pgmajfault",         M_MajorFault },
+	{ "pswpin",             M_SwapIn },
+	{ "pswpout",            M_SwapOut },
+	{ "pgscan_kswapd",      M_Scan },
+	{ "pgscan_direct",      M_Scan },
+	{ "pgscan_khugepaged",  M_Scan },
+	{ "pgscan_proactive",   M_Scan },
+	{ "pgsteal_kswapd",     M_Steal },
+	{ "pgsteal_direct",     M_Steal },
+	{ "pgsteal_khugepaged", M_Steal },
+	{ "pgsteal_proactive",  M_Steal },
+};
+
+static bool is_key(const char* line, const char* name, size_t length) {
+	return strncmp(line, name, length) == 0 && line[length] == ' ';
+}
+
+// The file has close to 200 counters and only a few are wanted, so where each one's line
+// starts is found here, in the order of the file
+VmstatActivity::VmstatActivity(const string &procRoot)
+	: _vmstat(procRoot + "/vmstat", 16 * 1024) {
+	const char* start = _vmstat.read();
+	if (!start) {
+		cout << "Opening /proc/vmstat failed, paging activity will read as 0" << endl;
+		return;
+	}
+	for (const char* pos = start; *pos; pos = next_line(pos)) {
+		for (const auto &key : keys) {
+			size_t length = strlen(key.name);
+			if (is_key(pos, key.name, length)) {
+				_keys.push_back(Key{ key.name, length, key.metric, static_cast<size_t>(pos - start), 0 });
+				break;
+			}
+		}
+	}
+}
+
+vector<MetricInfo> VmstatActivity::metrics() {
+	return { {"vm.pgfault", "/s", 0}, {"vm.pgmajfault", "/s", 0}, {"vm.pswpin", "/s", 0}, {"vm.pswpout", "/s", 0},
+	         {"vm.pgscan", "/s", 0}, {"vm.pgsteal", "/s", 0} };
+}
+
+chrono::milliseconds VmstatActivity::sample_period() {
+	return _swapping ? flashHalfPeriod : samplePeriod;
+}
+
+// One pread, and a number parsed per counter
+int VmstatActivity::sample_cost_us() {
+	return 10;
+}
+
+// Each counter is first looked for where its line was in the previous read. The values
+// before it are mostly gauges, so the lines shift by a byte now and then as one gains or
+// loses a digit, and the counter is then looked for line by line from the previous one.
+void VmstatActivity::sample(float* values) {
+	size_t length;
+	const char* start = _vmstat.read(length);
+	if (!start) {
+		return;
+	}
+	_clock.advance(_vmstat.read_time());
+	double rates[M_Count] = {};
+
+	const char* pos = start;
+	for (auto &key : _keys) {
+		const char* line = start + key.offset;
+		if (key.offset + key.length >= length || (key.offset > 0 && line[-1] != '\n')
+		    || !is_key(line, key.name, key.length)) {
+			line = find_key(pos, key);
+			if (!line) {
+				continue;
+			}
+			key.offset = line - start;
+		}
+		pos = line + key.length;
+		unsigned long long value = parse_uint(pos);
+		rates[key.metric] += _clock.rate(value, key.previous);
+		key.previous = value;
+		pos = next_line(pos);
+	}
+
+	for (int metric = 0; metric < M_Count; ++metric) {
+		values[metric] = static_cast<float>(rates[metric]);
+	}
+	_swapping = rates[M_SwapIn] > 0;
+}
+
+//
+// Private methods
+//
+
+const char* VmstatActivity::find_key(const char* pos, const Key &key) {
+	for (; *pos; pos = next_line(pos)) {
+		if (is_key(pos, key.name, key.length)) {
+			return pos;
+		}
+	}
+	return nullptr;
+}
+
+#endif
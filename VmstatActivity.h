@@ -0,0 +1,46 @@
+#ifndef __VmstatActivity_h__
+#define __VmstatActivity_h__
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "MetricSource.h"
+#include "ProcFile.h"
+#include "Rate.h"
+
+using namespace std;
+
+// Paging activity, from the counters in /proc/vmstat (Linux only). Publishes per second:
+// vm.pgfault and vm.pgmajfault (all page faults, and those that had to read from disk),
+// vm.pswpin and vm.pswpout (pages swapped in and out), and vm.pgscan and vm.pgsteal (pages
+// the kernel scanned and reclaimed, by kswapd and directly by allocating tasks).
+//
+// While pages are being swapped in it samples every flash half period, so the layout can
+// flash on it.
+class VmstatActivity : public MetricSource {
+	// A counter of the file this kernel has, in the order of the file
+	struct Key {
+		const char* name;
+		size_t length;
+		int metric;
+		size_t offset;    // of its line in the latest read
+		unsigned long long previous;
+	};
+	ProcFile _vmstat;
+	vector<Key> _keys;
+	RateClock _clock;
+	bool _swapping = false;
+
+	const char* find_key(const char* pos, const Key &key);
+
+  public:
+	// The root is only changed to point the source at a copy of the file, for benchmarks
+	VmstatActivity(const string &procRoot = "/proc");
+	vector<MetricInfo> metrics() override;
+	chrono::milliseconds sample_period() override;
+	int sample_cost_us() override;
+	void sample(float* values) override;
+};
+
+#endif
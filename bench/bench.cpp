@@ -0,0 +1,871 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <errno.h>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <filesystem>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "../ActivityReplay.h"
+#include "../ComputerActivity.h"
+#include "../DefaultSources.h"
+#include "../DiskActivity.h"
+#include "../FrequencyActivity.h"
+#include "../HwmonActivity.h"
+#include "../Layout.h"
+#include "../MetricRegistry.h"
+#include "../NetworkActivity.h"
+#include "../NumaActivity.h"
+#include "../PerfActivity.h"
+#include "../PressureActivity.h"
+#include "../ProcessActivity.h"
+#include "../ProcFile.h"
+#include "../ProcStat.h"
+#include "../RgbLighting.h"
+#include "../SelfActivity.h"
+#include "../SpatialLayout.h"
+#include "../Trace.h"
+#include "../VmstatActivity.h"
+
+using namespace std;
+
+//
+// Microbenchmarks for the sampling and render hot paths. Built against the mock
+// iCUE and NVML SDKs in bench/mock, so it runs anywhere g++ does:
+//
+//   pc-activity-rgb-bench [--filter substring] [--out file.json] [--replay recording]
+//   pc-activity-rgb-bench --check-allocs
+//
+// Results are written as JSON, one entry per benchmark, so runs can be diffed
+// over time to catch regressions. --check-allocs instead runs the full sample,
+// render and output cycle and fails if it allocates once warmed up. With --replay,
+// the render and output cycle is also timed on load from a recording made with
+// pc-activity-rgb --record.
+//
+
+//
+// Allocation counting. With glibc the malloc family is replaced, which glibc supports
+// and its own functions such as strdup() call too, so C library allocations count as
+// well as operator new, which allocates with malloc. Elsewhere only operator new is
+// counted. Kept out of line so GCC does not pair the inlined malloc and free against
+// new and delete.
+//
+
+static atomic<long long> allocationCount(0);
+
+#ifdef __GLIBC__
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void* __libc_valloc(size_t size);
+void* __libc_pvalloc(size_t size);
+void __libc_free(void* ptr);
+
+void* malloc(size_t size) {
+	allocationCount.fetch_add(1, memory_order_relaxed);
+	return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+	allocationCount.fetch_add(1, memory_order_relaxed);
+	return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+	allocationCount.fetch_add(1, memory_order_relaxed);
+	return __libc_realloc(ptr, size);
+}
+
+void* memalign(size_t alignment, size_t size) {
+	allocationCount.fetch_add(1, memory_order_relaxed);
+	return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+	return memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size) {
+	*ptr = memalign(alignment, size);
+	return *ptr ? 0 : ENOMEM;
+}
+
+void* valloc(size_t size) {
+	allocationCount.fetch_add(1, memory_order_relaxed);
+	return __libc_valloc(size);
+}
+
+void* pvalloc(size_t size) {
+	allocationCount.fetch_add(1, memory_order_relaxed);
+	return __libc_pvalloc(size);
+}
+
+void free(void* ptr) {
+	__libc_free(ptr);
+}
+}
+#endif
+
+__attribute__((noinline)) void* operator new(size_t size) {
+#ifndef __GLIBC__
+	allocationCount.fetch_add(1, memory_order_relaxed);
+#endif
+	if (void* ptr = malloc(size ? size : 1)) {
+		return ptr;
+	}
+	throw bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* ptr) noexcept {
+	free(ptr);
+}
+
+__attribute__((noinline)) void operator delete(void* ptr, size_t) noexcept {
+	free(ptr);
+}
+
+// The over-aligned forms, which libstdc++ would otherwise take from aligned_alloc out of
+// sight of the count on other platforms
+__attribute__((noinline)) void* operator new(size_t size, align_val_t alignment) {
+#ifdef _WIN32
+	allocationCount.fetch_add(1, memory_order_relaxed);
+	void* ptr = _aligned_malloc(size ? size : 1, static_cast<size_t>(alignment));
+#else
+#ifndef __GLIBC__
+	allocationCount.fetch_add(1, memory_order_relaxed);
+#endif
+	void* ptr = nullptr;
+	if (posix_memalign(&ptr, max(static_cast<size_t>(alignment), sizeof(void*)), size ? size : 1) != 0) {
+		ptr = nullptr;
+	}
+#endif
+	if (ptr) {
+		return ptr;
+	}
+	throw bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* ptr, align_val_t) noexcept {
+#ifdef _WIN32
+	_aligned_free(ptr);
+#else
+	free(ptr);
+#endif
+}
+
+__attribute__((noinline)) void operator delete(void* ptr, size_t, align_val_t alignment) noexcept {
+	operator delete(ptr, alignment);
+}
+
+struct BenchResult {
+	string name;
+	long long iterations;
+	double nsPerOp;
+	double allocsPerOp;
+	int leds;
+	// CPU time of every thread in the process, including any io_uring workers, and
+	// procfs reads made through ProcFile. Linux only, 0 elsewhere.
+	double cpuNsPerOp;
+	double syscallsPerOp;
+};
+
+// Keeps the compiler from discarding results of the code under test
+static volatile long long sink;
+
+static const chrono::milliseconds minBenchTime(200);
+
+static double process_cpu_ns() {
+#ifdef _WIN32
+	return 0;
+#else
+	timespec time;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+	return time.tv_sec * 1e9 + time.tv_nsec;
+#endif
+}
+
+static double syscall_count() {
+#ifdef _WIN32
+	return 0;
+#else
+	return static_cast<double>(ProcFile::syscall_count());
+#endif
+}
+
+// Runs fn in batches, doubling the batch size until it runs for at least minBenchTime
+static BenchResult run_bench(const string &name, int leds, const function<void()> &fn) {
+	long long iterations = 1;
+	while (true) {
+		long long allocations = allocationCount;
+		double cpuNs = process_cpu_ns();
+		double syscalls = syscall_count();
+		auto start = chrono::steady_clock::now();
+		for (long long i = 0; i < iterations; ++i) {
+			fn();
+		}
+		auto elapsed = chrono::steady_clock::now() - start;
+		if (elapsed >= minBenchTime || iterations >= (1LL << 40)) {
+			double ns = chrono::duration<double, nano>(elapsed).count();
+			return BenchResult{ name, iterations, ns / iterations,
+			                    (double)(allocationCount - allocations) / iterations, leds,
+			                    (process_cpu_ns() - cpuNs) / iterations, (syscall_count() - syscalls) / iterations };
+		}
+		iterations *= 2;
+	}
+}
+
+// Stock rig from devInfo (Commander Pro plus four DRAM sticks) with an extra
+// Lighting Node Pro carrying extraLeds, to scale the frame size
+static int setup_rig(int extraLeds) {
+	const CorsairDeviceType types[] = { CDT_CommanderPro, CDT_MemoryModule, CDT_MemoryModule,
+	                                    CDT_MemoryModule, CDT_MemoryModule, CDT_LightingNodePro };
+	const int ledCounts[] = { 54, 10, 10, 10, 10, extraLeds };
+	CorsairMockSetDevices(types, ledCounts, 6);
+	int total = 0;
+	for (auto count : ledCounts) {
+		total += count;
+	}
+	return total;
+}
+
+#ifndef _WIN32
+//
+// Fake procfs and sysfs trees, so the Linux sources can be timed on machines much
+// bigger than the one running the benchmark
+//
+
+static string make_fake_root() {
+	char path[] = "/tmp/pc-activity-rgb-bench-XXXXXX";
+	return mkdtemp(path) ? string(path) : string("/tmp");
+}
+
+static void make_dirs(const string &path) {
+	filesystem::create_directories(path);
+}
+
+static void write_file(const string &path, const string &contents) {
+	make_dirs(path.substr(0, path.rfind('/')));
+	ofstream(path) << contents;
+}
+
+// Big storage host: 24 NVMe drives with 8 partitions each and 120 device mapper
+// volumes on top, about 340 lines of /proc/diskstats
+static void make_fake_diskstats(const string &root) {
+	string diskstats;
+	auto add = [&](int major, int minor, const string &name, bool whole) {
+		diskstats += "  " + to_string(major) + "  " + to_string(minor) + " " + name;
+		for (int field = 0; field < 17; ++field) {
+			diskstats += " " + to_string(123456789ULL * (field + 1) + minor);
+		}
+		diskstats += "\n";
+		if (whole) {
+			make_dirs(root + "/sys/block/" + name);
+		}
+	};
+	for (int drive = 0; drive < 24; ++drive) {
+		string name = "nvme" + to_string(drive) + "n1";
+		add(259, drive * 9, name, true);
+		for (int part = 1; part <= 8; ++part) {
+			add(259, drive * 9 + part, name + "p" + to_string(part), false);
+		}
+	}
+	for (int volume = 0; volume < 120; ++volume) {
+		add(253, volume, "dm-" + to_string(volume), true);
+	}
+	write_file(root + "/proc/diskstats", diskstats);
+}
+
+// Container host: 4 physical ports, bridges and 200 veth pairs, about 210 lines of
+// /proc/net/dev. Only the physical ports have a device, the ports and veths report a
+// link speed.
+static void make_fake_net_dev(const string &root) {
+	string netDev = "Inter-|   Receive                                                |  Transmit\n"
+	                " face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop fifo colls carrier compressed\n";
+	auto add = [&](const string &name, int speed) {
+		netDev += string(name.size() < 6 ? 6 - name.size() : 0, ' ') + name + ":";
+		for (int field = 0; field < 16; ++field) {
+			netDev += " " + to_string(987654321ULL * (field + 1) + name.size());
+		}
+		netDev += "\n";
+		if (speed > 0) {
+			write_file(root + "/sys/class/net/" + name + "/speed", to_string(speed) + "\n");
+		}
+	};
+	auto device = [&](const string &name) {
+		write_file(root + "/sys/class/net/" + name + "/device/vendor", "0x8086\n");
+	};
+	add("lo", 0);
+	for (int port = 0; port < 4; ++port) {
+		add("eth" + to_string(port), 25000);
+		device("eth" + to_string(port));
+	}
+	add("docker0", 0);
+	add("br0", 0);
+	for (int veth = 0; veth < 200; ++veth) {
+		add("veth" + to_string(veth), 10000);
+	}
+	write_file(root + "/proc/net/dev", netDev);
+}
+
+// Two socket server with 64 CPUs each, all with cpufreq and Intel's throttle counters
+static void make_fake_cpufreq(const string &root) {
+	for (int cpu = 0; cpu < 128; ++cpu) {
+		string dir = root + "/sys/devices/system/cpu/cpu" + to_string(cpu);
+		write_file(dir + "/cpufreq/cpuinfo_max_freq", "4500000\n");
+		write_file(dir + "/cpufreq/scaling_cur_freq", to_string(1200000 + cpu * 25000) + "\n");
+		write_file(dir + "/topology/physical_package_id", to_string(cpu / 64) + "\n");
+		write_file(dir + "/thermal_throttle/core_throttle_count", to_string(cpu * 3) + "\n");
+		write_file(dir + "/thermal_throttle/package_throttle_count", "1234\n");
+	}
+}
+
+// Water-cooled workstation: CPU package and 16 cores, a fan controller with 6 fans and
+// 4 probes, one of them the coolant, 2 NVMe drives and the GPU. 31 sensors.
+static void make_fake_hwmon(const string &root) {
+	int number = 0;
+	auto chip = [&](const string &name) {
+		string dir = root + "/sys/class/hwmon/hwmon" + to_string(number++);
+		write_file(dir + "/name", name + "\n");
+		return dir;
+	};
+	auto sensor = [&](const string &dir, const string &attribute, const string &label, int value) {
+		write_file(dir + "/" + attribute + "_input", to_string(value) + "\n");
+		if (!label.empty()) {
+			write_file(dir + "/" + attribute + "_label", label + "\n");
+		}
+	};
+	string dir = chip("coretemp");
+	sensor(dir, "temp1", "Package id 0", 54000);
+	for (int core = 0; core < 16; ++core) {
+		sensor(dir, "temp" + to_string(core + 2), "Core " + to_string(core), 50000 + core * 500);
+	}
+	dir = chip("corsaircpro");
+	for (int fan = 1; fan <= 6; ++fan) {
+		sensor(dir, "fan" + to_string(fan), "", 800 + fan * 50);
+	}
+	sensor(dir, "temp1", "Coolant temp", 31500);
+	for (int probe = 2; probe <= 4; ++probe) {
+		sensor(dir, "temp" + to_string(probe), "", 30000 + probe * 1000);
+	}
+	for (int drive = 0; drive < 2; ++drive) {
+		sensor(chip("nvme"), "temp1", "Composite", 41850);
+	}
+	sensor(chip("amdgpu"), "temp1", "edge", 47000);
+}
+
+// /proc/stat of a 256 core server, with the intr line's 4000 per-IRQ counts
+static string make_proc_stat_256_cores() {
+	auto cpu_line = [](const string &name, unsigned long long base) {
+		string line = name;
+		for (int field = 0; field < 10; ++field) {
+			line += " " + to_string(field == 8 || field == 9 ? 0 : base * (field + 1) + 12345);
+		}
+		return line + "\n";
+	};
+	string stat = cpu_line("cpu ", 256 * 987654);
+	for (int core = 0; core < 256; ++core) {
+		stat += cpu_line("cpu" + to_string(core), 987654 + core);
+	}
+	stat += "intr 9876543210";
+	for (int irq = 0; irq < 4000; ++irq) {
+		stat += irq % 7 ? " 0" : " " + to_string(irq * 1234);
+	}
+	stat += "\nctxt 123456789012\nbtime 1792399886\nprocesses 7240123\nprocs_running 17\nprocs_blocked 2\n"
+	        "softirq 91875 0 40161 1 3524 0 0 1 0 0 48188\n";
+	return stat;
+}
+
+// Two socket server with 256 CPUs, half on each node with its SMT siblings
+static void make_fake_numa(const string &root) {
+	const char* keys[] = { "MemTotal", "MemFree", "MemUsed", "SwapCached", "Active", "Inactive", "Active(anon)",
+	                       "Inactive(anon)", "Active(file)", "Inactive(file)", "Unevictable", "Mlocked", "Dirty",
+	                       "Writeback", "FilePages", "Mapped", "AnonPages", "Shmem", "KernelStack", "PageTables",
+	                       "SecPageTables", "NFS_Unstable", "Bounce", "WritebackTmp", "KReclaimable", "Slab",
+	                       "SReclaimable", "SUnreclaim", "AnonHugePages", "ShmemHugePages", "HugePages_Total",
+	                       "HugePages_Free", "HugePages_Surp" };
+	write_file(root + "/sys/devices/system/node/online", "0-1\n");
+	for (int node = 0; node < 2; ++node) {
+		string dir = root + "/sys/devices/system/node/node" + to_string(node);
+		write_file(dir + "/cpulist", node == 0 ? "0-63,128-191\n" : "64-127,192-255\n");
+		string meminfo;
+		for (const char* key : keys) {
+			string name = "Node " + to_string(node) + " " + key + ":";
+			meminfo += name + string(name.size() < 24 ? 24 - name.size() : 1, ' ')
+			           + to_string(strcmp(key, "MemTotal") == 0 ? 263921532 : 263921532 / (4 * strlen(key) + node))
+			           + " kB\n";
+		}
+		write_file(dir + "/meminfo", meminfo);
+	}
+	write_file(root + "/proc/stat", make_proc_stat_256_cores());
+}
+
+// Big container host: 20000 processes, in /proc/<pid>/stat
+static void make_fake_processes(const string &root, int count) {
+	for (int pid = 1; pid <= count; ++pid) {
+		write_file(root + "/proc/" + to_string(pid) + "/stat",
+		           to_string(pid) + " (worker " + to_string(pid % 97) + ") S 1 " + to_string(pid) + " "
+		           + to_string(pid) + " 0 -1 4194560 1523 0 0 0 " + to_string(pid % 500) + " "
+		           + to_string(pid % 70) + " 0 0 20 0 1 0 " + to_string(1000 + pid)
+		           + " 12345678 456 18446744073709551615 1 1 0 0 0 0 0 0 0 0 0 0 0 0 17 0 0 0 0 0 0\n");
+	}
+}
+#endif
+
+static Theme bench_theme() {
+	Theme theme;
+	theme.cpu_base = theme.gpu_base = theme.fans_one = {66, 230, 245};
+	theme.cpu_active = theme.gpu_active = theme.pump_hot = {255, 0, 0};
+	theme.cpu_system = {255, 110, 0};
+	theme.cpu_irq = theme.pump = theme.fans_zero = {245, 242, 32};
+	theme.cpu_iowait = {150, 0, 255};
+	theme.cpu_steal = {255, 255, 255};
+	theme.ram_base = {60, 60, 8};
+	theme.ram_active = {64, 0, 0};
+	theme.ram_cache = {12, 46, 50};
+	theme.alert = {255, 0, 160};
+	theme.throttle = {255, 255, 255};
+	return theme;
+}
+static const Theme benchTheme = bench_theme();
+
+// Takes the status line and drops it, so formatting it is measured without the terminal
+class DiscardBuffer : public streambuf {
+  protected:
+	int overflow(int c) override {
+		return c;
+	}
+};
+static DiscardBuffer discardBuffer;
+static ostream discardStream(&discardBuffer);
+
+// Sample, status line, render and output, the whole of one iteration of main()'s loop,
+// drawn with spatial if given as with --spatial. Sources are sampled as if their period
+// had passed since the last cycle.
+static void run_cycle(MetricRegistry &registry, Layout &layout, SpatialLayout* spatial, RgbLighting &lighting,
+                      LedMap &ledMap, chrono::steady_clock::time_point &now, const vector<MetricId> &statusMetrics) {
+	now += defaultSamplePeriod;
+	registry.sample_due(now);
+	if (lighting.check_devices(now)) {
+		layout.update_devices(registry, lighting.get_device_registry(), lighting.changed_devices());
+		if (spatial) {
+			spatial->update_devices(lighting.get_device_registry());
+		}
+	}
+	registry.print_status_line(discardStream, statusMetrics, time(NULL));
+	discardStream << endl;
+	if (spatial) {
+		spatial->render(registry, now, ledMap);
+	}
+	else {
+		layout.render(registry, ledMap);
+	}
+	lighting.set_colors(ledMap);
+}
+
+#ifndef _WIN32
+// Ends the previous child and starts another that waits to be ended, so each cycle one
+// process exits and one starts, as on a busy host
+static pid_t churn_process(pid_t previous) {
+	if (previous > 0) {
+		kill(previous, SIGKILL);
+		waitpid(previous, nullptr, 0);
+	}
+	pid_t child = fork();
+	if (child == 0) {
+		pause();
+		_exit(0);
+	}
+	return child;
+}
+#endif
+
+// Fails if any steady-state cycle allocates. The process scan is on, as --top turns it
+// on, and sees processes start and exit.
+static int check_allocations() {
+	const int warmupCycles = 3;
+	const int checkedCycles = 100;
+	setup_rig(500);
+	MetricRegistry registry;
+	SourceOptions options;
+	options.topProcesses = 5;
+	register_default_sources(registry, options);
+	RgbLighting lighting;
+	Layout layout(&lighting, lighting.get_device_registry(), registry, benchTheme);
+	SpatialLayout spatialLayout(&lighting, lighting.get_device_registry(), registry, benchTheme);
+	// Every metric on the status line, as with --verbose
+	vector<MetricId> statusMetrics;
+	for (MetricId id = 0; id < registry.metric_count(); ++id) {
+		statusMetrics.push_back(id);
+	}
+	LedMap ledMap;
+	auto now = chrono::steady_clock::now();
+	int failed = 0;
+	for (SpatialLayout* spatial : { static_cast<SpatialLayout*>(nullptr), &spatialLayout }) {
+		for (int i = 0; i < warmupCycles; ++i) {
+			run_cycle(registry, layout, spatial, lighting, ledMap, now, statusMetrics);
+		}
+		long long allocations = allocationCount;
+#ifndef _WIN32
+		pid_t child = 0;
+#endif
+		for (int i = 0; i < checkedCycles; ++i) {
+#ifndef _WIN32
+			child = churn_process(child);
+#endif
+			run_cycle(registry, layout, spatial, lighting, ledMap, now, statusMetrics);
+		}
+#ifndef _WIN32
+		kill(child, SIGKILL);
+		waitpid(child, nullptr, 0);
+#endif
+		allocations = allocationCount - allocations;
+		cerr << allocations << " allocations in " << checkedCycles << " steady-state cycles"
+		     << (spatial ? " with --spatial" : "") << endl;
+		failed |= allocations != 0;
+	}
+	return failed;
+}
+
+static void write_json(ostream &out, const vector<BenchResult> &results) {
+	out << "{\n";
+	out << "  \"context\": {\n";
+#ifdef _WIN32
+	out << "    \"platform\": \"windows\",\n";
+#else
+	out << "    \"platform\": \"linux\",\n";
+#endif
+	out << "    \"compiler\": \"" << __VERSION__ << "\",\n";
+	out << "    \"min_time_ms\": " << minBenchTime.count() << "\n";
+	out << "  },\n";
+	out << "  \"benchmarks\": [\n";
+	for (size_t i = 0; i < results.size(); ++i) {
+		const auto &r = results[i];
+		out << "    {\"name\": \"" << r.name << "\", \"iterations\": " << r.iterations
+		    << ", \"ns_per_op\": " << r.nsPerOp << ", \"allocs_per_op\": " << r.allocsPerOp;
+		if (r.leds > 0) {
+			out << ", \"leds\": " << r.leds;
+		}
+		if (r.cpuNsPerOp > 0) {
+			out << ", \"cpu_ns_per_op\": " << r.cpuNsPerOp;
+		}
+		if (r.syscallsPerOp > 0) {
+			out << ", \"syscalls_per_op\": " << r.syscallsPerOp;
+		}
+		out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "  ]\n";
+	out << "}\n";
+}
+
+int main(int argc, char **argv) {
+	string filter, outPath, replayPath;
+	bool checkAllocs = false;
+	for (int i = 1; i < argc; ++i) {
+		string arg(argv[i]);
+		if (arg == "--filter" && i + 1 < argc) {
+			filter = argv[++i];
+		}
+		else if (arg == "--out" && i + 1 < argc) {
+			outPath = argv[++i];
+		}
+		else if (arg == "--replay" && i + 1 < argc) {
+			replayPath = argv[++i];
+		}
+		else if (arg == "--check-allocs") {
+			checkAllocs = true;
+		}
+		else {
+			cerr << "Usage: " << argv[0] << " [--filter substring] [--out file.json] [--replay recording] | --check-allocs"
+			     << endl;
+			return 1;
+		}
+	}
+
+	// The code under test logs to cout, keep that out of the JSON
+	auto *jsonBuf = cout.rdbuf(nullptr);
+	if (checkAllocs) {
+		return check_allocations();
+	}
+
+	vector<BenchResult> results;
+	auto bench = [&](const string &name, int leds, const function<void()> &fn) {
+		if (filter.empty() || name.find(filter) != string::npos) {
+			results.push_back(run_bench(name, leds, fn));
+			cerr << name << ": " << results.back().nsPerOp << " ns/op" << endl;
+		}
+	};
+
+	//
+	// Sampling
+	//
+	ComputerActivity activity;
+	bench("sample/memory_usage", 0, [&] { sink = activity.get_memory_usage(); });
+	bench("sample/cpu_load", 0, [&] { sink = activity.get_cpu_load(); });
+	bench("sample/gpu_load", 0, [&] { sink = activity.get_gpu_load(); });
+	SelfActivity self;
+	bench("sample/self", 0, [&] {
+		self.sample();
+		sink = self.get_rss_bytes();
+	});
+	MetricRegistry registry;
+	register_default_sources(registry);
+	auto now = chrono::steady_clock::now();
+	bench("registry/sample_all", 0, [&] {
+		now += defaultSamplePeriod;
+		sink = registry.sample_due(now);
+	});
+#ifndef _WIN32
+	string fakeRoot = make_fake_root();
+	make_fake_diskstats(fakeRoot);
+	DiskActivity disks(fakeRoot + "/proc", fakeRoot + "/sys");
+	vector<float> diskValues(disks.metrics().size());
+	bench("sample/diskstats_144_disks", 0, [&] {
+		disks.sample(diskValues.data());
+		sink = diskValues[0];
+	});
+	make_fake_cpufreq(fakeRoot);
+	FrequencyActivity frequency(fakeRoot + "/sys");
+	vector<float> frequencyValues(frequency.metrics().size());
+	bench("sample/cpufreq_128_cpus", 0, [&] {
+		frequency.sample(frequencyValues.data());
+		sink = frequencyValues[0];
+	});
+	make_fake_numa(fakeRoot);
+	NumaActivity numa(4, {}, fakeRoot + "/sys", fakeRoot + "/proc");
+	vector<float> numaValues(numa.metrics().size());
+	bench("sample/numa_2_nodes_256_cpus", 0, [&] {
+		numa.sample(numaValues.data());
+		sink = numaValues[0];
+	});
+	make_fake_hwmon(fakeRoot);
+	HwmonActivity hwmon(fakeRoot + "/sys");
+	vector<float> hwmonValues(hwmon.metrics().size());
+	bench("sample/hwmon_31_sensors", 0, [&] {
+		hwmon.sample(hwmonValues.data());
+		sink = hwmonValues[0];
+	});
+	for (const char* resource : { "cpu", "memory", "io" }) {
+		write_file(fakeRoot + "/proc/pressure/" + resource,
+		           "some avg10=1.22 avg60=1.59 avg300=1.32 total=22611351\n"
+		           "full avg10=0.00 avg60=0.00 avg300=0.00 total=0\n");
+	}
+	PressureActivity pressure(fakeRoot + "/proc");
+	vector<float> pressureValues(pressure.metrics().size());
+	bench("sample/pressure", 0, [&] {
+		pressure.sample(pressureValues.data());
+		sink = pressureValues[0];
+	});
+	// The real file, since every kernel has one and its counters are what it is made of
+	VmstatActivity vmstat;
+	vector<float> vmstatValues(vmstat.metrics().size());
+	bench("sample/vmstat", 0, [&] {
+		vmstat.sample(vmstatValues.data());
+		sink = vmstatValues[0];
+	});
+	string cgroup = fakeRoot + "/sys/fs/cgroup/system.slice/bench.service";
+	write_file(cgroup + "/cpu.stat", "usage_usec 494985491\nuser_usec 441392297\nsystem_usec 53593194\n"
+	                                 "nr_periods 0\nnr_throttled 0\nthrottled_usec 0\n");
+	write_file(cgroup + "/cpu.max", "200000 100000\n");
+	write_file(cgroup + "/cpuset.cpus.effective", "0-7\n");
+	write_file(cgroup + "/memory.current", "1073741824\n");
+	write_file(cgroup + "/memory.max", "max\n");
+	write_file(cgroup + "/io.stat", "259:0 rbytes=1234567 wbytes=7654321 rios=12 wios=34 dbytes=0 dios=0\n"
+	                                "253:0 rbytes=1234567 wbytes=7654321 rios=12 wios=34 dbytes=0 dios=0\n");
+	write_file(cgroup + "/cpu.pressure", "some avg10=1.70 avg60=3.94 avg300=2.11 total=30430017\n"
+	                                     "full avg10=0.00 avg60=0.00 avg300=0.00 total=0\n");
+
+	// A tick with every metric due, reading the files with a pread each and then as one
+	// io_uring batch. Compare syscalls_per_op and cpu_ns_per_op, which unlike ns_per_op
+	// counts the io_uring workers procfs reads are handed to.
+	vector<AdaptiveRange> everyTick = { { "memory.usage", chrono::milliseconds(0), chrono::milliseconds(0), 0 },
+	                                    { "cpu.load", chrono::milliseconds(0), chrono::milliseconds(0), 0 },
+	                                    { "gpu.load", chrono::milliseconds(0), chrono::milliseconds(0), 0 } };
+	for (bool ioUring : { false, true }) {
+		string backend = ioUring ? "io_uring" : "pread";
+		ComputerActivity machine("", everyTick, ioUring);
+		vector<float> machineValues(machine.metrics().size());
+		bench("tick/machine/" + backend, 0, [&] {
+			machine.sample(machineValues.data());
+			sink = machineValues[1];
+		});
+		ComputerActivity group(cgroup, everyTick, ioUring);
+		vector<float> groupValues(group.metrics().size());
+		bench("tick/cgroup/" + backend, 0, [&] {
+			group.sample(groupValues.data());
+			sink = groupValues[1];
+		});
+	}
+	// Real counters, as perf events can not be faked. Software events only on machines
+	// without a PMU, such as most VMs.
+	PerfActivity perf;
+	vector<float> perfValues(perf.metrics().size());
+	if (!perfValues.empty()) {
+		bench(string("sample/perf_") + (perf.hardware() ? "hardware" : "software"), 0, [&] {
+			perf.sample(perfValues.data());
+			sink = perfValues[0];
+		});
+	}
+	make_fake_processes(fakeRoot, 20000);
+	{
+		// Closed again before the next benchmark, as the scan keeps thousands of fds open
+		ProcessActivity processes(5, fakeRoot + "/proc");
+		vector<float> processValues(processes.metrics().size());
+		bench("sample/top_processes_20k", 0, [&] {
+			processes.sample(processValues.data());
+			sink = processes.process_count();
+		});
+	}
+	make_fake_net_dev(fakeRoot);
+	NetworkActivity network({}, {"lo"}, fakeRoot + "/proc", fakeRoot + "/sys");
+	vector<float> networkValues(network.metrics().size());
+	bench("sample/net_dev_206_interfaces", 0, [&] {
+		network.sample(networkValues.data());
+		sink = networkValues[0];
+	});
+#endif
+	string procStatText = make_proc_stat_256_cores();
+	ProcStat procStat(256);
+	bench("parse/proc_stat_256_cores", 0, [&] {
+		parse_proc_stat(procStatText.c_str(), procStat);
+		sink = procStat.contextSwitches;
+	});
+	unsigned long long ticks = 0;
+	bench("cpu_delta", 0, [&] {
+		ticks += 1000;
+		sink = static_cast<long long>(activity.calculate_cpu_load(ticks / 4, ticks) * 100);
+	});
+
+#ifdef PC_ACTIVITY_TRACE
+	// Budget is 50 ns per recorded stage
+	bench("trace/event", 0, [&] { TRACE_SCOPE("bench"); });
+#endif
+
+	//
+	// Rendering
+	//
+	setup_rig(0);
+	RgbLighting lighting;
+	const DeviceRegistry &devices = lighting.get_device_registry();
+	LedMap ledMap;
+	lighting.get_led_arrays(ledMap);
+	int commander = devices.byType[CDT_CommanderPro][0];
+	LedStrip cpuStrip = lighting.make_strip("cpu", 0, { commander });
+	LedStrip fanStrip = lighting.make_strip("fan", 0, { commander });
+	LedStrip reservoirStrip = lighting.make_strip("reservoir", 0, { commander });
+	LedStrip ramStrip = lighting.make_strip("ram", 0, devices.byType[CDT_MemoryModule]);
+	Color base{66, 230, 245}, active{255, 0, 0};
+	int pct = 0;
+	bench("load_device_colors_activity", 16, [&] {
+		pct = (pct + 7) % 101;
+		lighting.load_device_colors_activity(cpuStrip, pct, ledMap, base, active);
+	});
+	unsigned int number = 0;
+	bench("load_device_colors_binary", 4, [&] {
+		number = (number + 1) % 16;
+		lighting.load_device_colors_binary(fanStrip, number, ledMap, base, active);
+	});
+	// CPU time split seven ways, the tops moving so each frame fills different LEDs
+	float tops[7];
+	Color layerColors[7] = { active, active, {255, 110, 0}, {245, 242, 32}, {245, 242, 32}, {150, 0, 255}, {255, 255, 255} };
+	float shift = 0;
+	bench("load_device_colors_stacked", 16, [&] {
+		shift = shift < 10 ? shift + 1.3f : 0;
+		for (int layer = 0; layer < 7; ++layer) {
+			tops[layer] = (layer + 1) * (8 + shift);
+		}
+		lighting.load_device_colors_stacked(cpuStrip, tops, layerColors, 7, 0, 100, ledMap, base);
+	});
+	// Used and cached RAM across all four sticks as one strip
+	bench("load_device_colors_stacked/ram_strip", 40, [&] {
+		shift = shift < 10 ? shift + 1.3f : 0;
+		tops[0] = 40 + shift;
+		tops[1] = 70 + shift;
+		lighting.load_device_colors_stacked(ramStrip, tops, layerColors + 1, 2, 0, 100, ledMap, base);
+	});
+	bench("load_device_colors_static", 10, [&] {
+		lighting.load_device_colors_static(reservoirStrip, ledMap, base);
+	});
+
+	// The hotplug check, with nothing changed
+	auto checkTime = chrono::steady_clock::now();
+	bench("check_devices", 0, [&] {
+		checkTime += chrono::seconds(5);
+		sink = lighting.check_devices(checkTime);
+	});
+
+	MetricId cpuLoad = registry.find("cpu.load");
+	MetricId gpuLoad = registry.find("gpu.load");
+	MetricId memoryUsage = registry.find("memory.usage");
+	for (int extraLeds : { 50, 500, 5000 }) {
+		int total = setup_rig(extraLeds);
+		Layout layout(&lighting, lighting.get_device_registry(), registry, benchTheme);
+		bench("frame_build/extra_leds:" + to_string(extraLeds), total, [&] {
+			pct = (pct + 7) % 101;
+			registry.set_value(cpuLoad, pct);
+			registry.set_value(gpuLoad, 100 - pct);
+			registry.set_value(memoryUsage, pct / 2);
+			layout.render(registry, ledMap);
+			sink = ledMap.size();
+		});
+		// A jump in CPU load every 10 frames keeps several ripples spreading over the fill
+		SpatialLayout spatial(&lighting, lighting.get_device_registry(), registry, benchTheme);
+		auto frameTime = chrono::steady_clock::now();
+		int frame = 0;
+		bench("spatial_frame/extra_leds:" + to_string(extraLeds), total, [&] {
+			frameTime += chrono::milliseconds(33);
+			registry.set_value(cpuLoad, ++frame % 10 == 0 ? 90 : 20);
+			spatial.render(registry, frameTime, ledMap);
+			sink = ledMap.size();
+		});
+		bench("set_colors/extra_leds:" + to_string(extraLeds), total, [&] {
+			lighting.set_colors(ledMap);
+			sink = CorsairMockFlushCount();
+		});
+	}
+
+	if (!replayPath.empty()) {
+		MetricRegistry replayRegistry;
+		auto replay = new ActivityReplay(replayPath, false);
+		replayRegistry.add(replay);
+		int total = setup_rig(0);
+		Layout layout(&lighting, lighting.get_device_registry(), replayRegistry, benchTheme);
+		vector<MetricId> statusMetrics = layout.bound_metrics();
+		auto replayNow = chrono::steady_clock::now();
+		bench("replay_cycle", total, [&] {
+			if (replay->finished()) {
+				replay->rewind();
+			}
+			run_cycle(replayRegistry, layout, nullptr, lighting, ledMap, replayNow, statusMetrics);
+		});
+	}
+
+#ifndef _WIN32
+	filesystem::remove_all(fakeRoot);
+#endif
+
+	cout.rdbuf(jsonBuf);
+	if (outPath.empty()) {
+		write_json(cout, results);
+	}
+	else {
+		ofstream out(outPath);
+		write_json(out, results);
+	}
+	return 0;
+}
@@ -0,0 +1,90 @@
+#ifndef __CUESDK_mock_h__
+#define __CUESDK_mock_h__
+
+//
+// Stand-in for the subset of the iCUE SDK (v3) used by RgbLighting, so the benchmarks
+// can build and run on machines without iCUE or Corsair hardware. Put bench/mock ahead
+// of the real SDK include path to pick this up.
+//
+
+enum CorsairDeviceType {
+	CDT_Unknown = 0,
+	CDT_Mouse = 1,
+	CDT_Keyboard = 2,
+	CDT_Headset = 3,
+	CDT_MouseMat = 4,
+	CDT_HeadsetStand = 5,
+	CDT_CommanderPro = 6,
+	CDT_LightingNodePro = 7,
+	CDT_MemoryModule = 8,
+	CDT_Cooler = 9
+};
+
+enum CorsairError {
+	CE_Success = 0,
+	CE_ServerNotFound = 1,
+	CE_NoControl = 2,
+	CE_ProtocolHandshakeMissing = 3,
+	CE_IncompatibleProtocol = 4,
+	CE_InvalidArguments = 5
+};
+
+// The real enum names every LED on every device, the mock only hands out numbers
+enum CorsairLedId {
+	CLI_Invalid = 0
+};
+
+struct CorsairDeviceInfo {
+	CorsairDeviceType type;
+	const char* model;
+	int capsMask;
+	int ledsCount;
+};
+
+struct CorsairLedPosition {
+	CorsairLedId ledId;
+	double top;
+	double left;
+	double height;
+	double width;
+};
+
+struct CorsairLedPositions {
+	int numberOfLed;
+	CorsairLedPosition* pLedPosition;
+};
+
+struct CorsairLedColor {
+	CorsairLedId ledId;
+	int r;
+	int g;
+	int b;
+};
+
+struct CorsairProtocolDetails {
+	const char* sdkVersion;
+	const char* serverVersion;
+	int sdkProtocolVersion;
+	int serverProtocolVersion;
+	bool breakingChanges;
+};
+
+CorsairProtocolDetails CorsairPerformProtocolHandshake();
+CorsairError CorsairGetLastError();
+int CorsairGetDeviceCount();
+CorsairDeviceInfo* CorsairGetDeviceInfo(int deviceIndex);
+CorsairLedPositions* CorsairGetLedPositionsByDeviceIndex(int deviceIndex);
+bool CorsairSetLedsColorsBufferByDeviceIndex(int deviceIndex, int size, CorsairLedColor* ledsColors);
+bool CorsairSetLedsColorsFlushBuffer();
+
+//
+// Mock controls
+//
+
+// Replaces the attached devices, LEDs are laid out left to right in rows of 10
+void CorsairMockSetDevices(const CorsairDeviceType* types, const int* ledCounts, int count);
+// Number of LED colors buffered since the last flush, and flushes so far
+int CorsairMockBufferedLeds();
+int CorsairMockFlushCount();
+
+#endif
@@ -0,0 +1,128 @@
+#include <vector>
+
+extern "C" {
+	#include "../../nvml.h"
+}
+
+#include "CUESDK.h"
+
+using namespace std;
+
+//
+// iCUE SDK mock - devices live in memory, buffered colors are copied like the
+// real SDK does and dropped on flush
+//
+
+struct MockDevice {
+	CorsairDeviceInfo info;
+	vector<CorsairLedPosition> positions;
+	CorsairLedPositions ledPositions;
+	vector<CorsairLedColor> colors;
+};
+
+static vector<MockDevice> devices;
+static int bufferedLeds = 0;
+static int flushCount = 0;
+
+void CorsairMockSetDevices(const CorsairDeviceType* types, const int* ledCounts, int count) {
+	devices.clear();
+	devices.resize(count);
+	for (int deviceIdx = 0; deviceIdx < count; ++deviceIdx) {
+		auto &dev = devices[deviceIdx];
+		dev.info = CorsairDeviceInfo{ types[deviceIdx], "Mock", 1, ledCounts[deviceIdx] };
+		for (int i = 0; i < ledCounts[deviceIdx]; ++i) {
+			dev.positions.push_back(CorsairLedPosition{ static_cast<CorsairLedId>(i + 1),
+			                                            (double)(deviceIdx * 100 + (i / 10) * 10),
+			                                            (double)((i % 10) * 10), 8.0, 8.0 });
+		}
+		dev.ledPositions = CorsairLedPositions{ ledCounts[deviceIdx], dev.positions.data() };
+		dev.colors.resize(ledCounts[deviceIdx]);
+	}
+	bufferedLeds = 0;
+	flushCount = 0;
+}
+
+int CorsairMockBufferedLeds() {
+	return bufferedLeds;
+}
+
+int CorsairMockFlushCount() {
+	return flushCount;
+}
+
+CorsairProtocolDetails CorsairPerformProtocolHandshake() {
+	return CorsairProtocolDetails{ "mock", "mock", 3, 3, false };
+}
+
+CorsairError CorsairGetLastError() {
+	return CE_Success;
+}
+
+int CorsairGetDeviceCount() {
+	return static_cast<int>(devices.size());
+}
+
+CorsairDeviceInfo* CorsairGetDeviceInfo(int deviceIndex) {
+	if (deviceIndex < 0 || deviceIndex >= static_cast<int>(devices.size())) {
+		return nullptr;
+	}
+	return &devices[deviceIndex].info;
+}
+
+CorsairLedPositions* CorsairGetLedPositionsByDeviceIndex(int deviceIndex) {
+	if (deviceIndex < 0 || deviceIndex >= static_cast<int>(devices.size())) {
+		return nullptr;
+	}
+	return &devices[deviceIndex].ledPositions;
+}
+
+bool CorsairSetLedsColorsBufferByDeviceIndex(int deviceIndex, int size, CorsairLedColor* ledsColors) {
+	if (deviceIndex < 0 || deviceIndex >= static_cast<int>(devices.size())
+	    || size > static_cast<int>(devices[deviceIndex].colors.size())) {
+		return false;
+	}
+	for (int i = 0; i < size; ++i) {
+		devices[deviceIndex].colors[i] = ledsColors[i];
+	}
+	bufferedLeds += size;
+	return true;
+}
+
+bool CorsairSetLedsColorsFlushBuffer() {
+	bufferedLeds = 0;
+	++flushCount;
+	return true;
+}
+
+//
+// NVML mock - a single GPU reporting a fixed utilization
+//
+
+static nvmlDevice_t mockGpu = reinterpret_cast<nvmlDevice_t>(&flushCount);
+
+nvmlReturn_t nvmlInit_v2(void) {
+	return NVML_SUCCESS;
+}
+
+const char* nvmlErrorString(nvmlReturn_t result) {
+	return result == NVML_SUCCESS ? "Success" : "Mock error";
+}
+
+nvmlReturn_t nvmlDeviceGetCount_v2(unsigned int *deviceCount) {
+	*deviceCount = 1;
+	return NVML_SUCCESS;
+}
+
+nvmlReturn_t nvmlDeviceGetHandleByIndex_v2(unsigned int index, nvmlDevice_t *device) {
+	if (index != 0) {
+		return NVML_ERROR_INVALID_ARGUMENT;
+	}
+	*device = mockGpu;
+	return NVML_SUCCESS;
+}
+
+nvmlReturn_t nvmlDeviceGetUtilizationRates(nvmlDevice_t device, nvmlUtilization_t *utilization) {
+	utilization->gpu = 42;
+	utilization->memory = 17;
+	return NVML_SUCCESS;
+}
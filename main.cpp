@@ -1,89 +1,272 @@
+#include <algorithm>
 #include <iostream>
-#include <iomanip>
 #include <array>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <thread>
 
-#include "ComputerActivity.h"
+#include "ActivityRecorder.h"
+#include "ActivityReplay.h"
+#include "DefaultSources.h"
+#include "Layout.h"
+#include "MetricRegistry.h"
 #include "RgbLighting.h"
+#include "SpatialLayout.h"
+#include "Trace.h"
 
 using namespace std;
 
+// Splits a comma separated command line value
+static vector<string> split_list(const char* list) {
+	vector<string> items;
+	string item;
+	for (const char* pos = list; ; ++pos) {
+		if (*pos == ',' || *pos == '\0') {
+			if (!item.empty()) {
+				items.push_back(item);
+			}
+			item.clear();
+			if (!*pos) {
+				break;
+			}
+		}
+		else {
+			item += *pos;
+		}
+	}
+	return items;
+}
+
+// Always on the status line, with the metrics the layout shows. --verbose prints every metric.
+static const char* summaryMetrics[] = { "memory.usage", "cpu.load", "gpu.load", "self.cpu", "self.rss" };
+
+static vector<MetricId> status_metrics(const MetricRegistry &registry, const Layout &layout, bool verbose) {
+	vector<MetricId> metrics;
+	if (verbose) {
+		for (MetricId id = 0; id < registry.metric_count(); ++id) {
+			metrics.push_back(id);
+		}
+		return metrics;
+	}
+	metrics = layout.bound_metrics();
+	for (const char* name : summaryMetrics) {
+		MetricId id = registry.find(name);
+		if (id >= 0) {
+			metrics.push_back(id);
+		}
+	}
+	sort(metrics.begin(), metrics.end());
+	metrics.erase(unique(metrics.begin(), metrics.end()), metrics.end());
+	return metrics;
+}
+
 // Colors
-Color cpu_base, cpu_active, gpu_base, gpu_active, ram_base, ram_active, pump, fans_one, fans_zero;
+Theme theme;
 
 void green_theme() {
 	Color green{0, 255, 0};
 	Color red{255, 0, 0};
+	Color magenta{255, 0, 160};
+	Color orange{255, 110, 0};
+	Color yellow{255, 230, 0};
+	Color blue{0, 64, 255};
+	Color white{255, 255, 255};
 	Color green_dim{0, 32, 0};
 	Color red_dim{32, 0, 0};
+	Color blue_dim{0, 0, 40};
 	Color off{0, 0, 0};
-	cpu_base = gpu_base = green;
-	cpu_active = gpu_active = red;
-	ram_base = green_dim;
-	ram_active = red_dim;
-	fans_one = green;
-	fans_zero = off;
-	pump = green;
+	theme.cpu_base = theme.gpu_base = green;
+	theme.cpu_active = theme.gpu_active = red;
+	theme.cpu_system = orange;
+	theme.cpu_irq = yellow;
+	theme.cpu_iowait = blue;
+	theme.cpu_steal = white;
+	theme.ram_base = green_dim;
+	theme.ram_active = red_dim;
+	theme.ram_cache = blue_dim;
+	theme.fans_one = green;
+	theme.fans_zero = off;
+	theme.pump = green;
+	theme.pump_hot = red;
+	theme.alert = magenta;
+	theme.throttle = white;
 }
 
 void cyberpunk_theme() {
 	Color yellow{245, 242, 32};
 	Color blue{66, 230, 245};
 	Color red{255, 0, 0};
+	Color magenta{255, 0, 160};
+	Color orange{255, 110, 0};
+	Color purple{150, 0, 255};
+	Color white{255, 255, 255};
 	Color yellow_dim{60, 60, 8};
 	Color red_dim{64, 0, 0};
+	Color blue_dim{12, 46, 50};
 	Color off{0, 0, 0};
 
-	cpu_base = gpu_base = blue;
-	cpu_active = gpu_active = red;
-	ram_base = yellow_dim;
-	ram_active = red_dim;
-	pump = yellow;
-	fans_one = blue;
-	fans_zero = yellow;
+	theme.cpu_base = theme.gpu_base = blue;
+	theme.cpu_active = theme.gpu_active = red;
+	theme.cpu_system = orange;
+	theme.cpu_irq = yellow;
+	theme.cpu_iowait = purple;
+	theme.cpu_steal = white;
+	theme.ram_base = yellow_dim;
+	theme.ram_active = red_dim;
+	theme.ram_cache = blue_dim;
+	theme.pump = yellow;
+	theme.pump_hot = red;
+	theme.fans_one = blue;
+	theme.fans_zero = yellow;
+	theme.alert = magenta;
+	theme.throttle = white;
 }
 
-int main() {
-	ComputerActivity* activity = new ComputerActivity();
+int main(int argc, char** argv) {
+	// Save the metrics to a file, or show a saved file instead of this machine
+	const char* recordPath = nullptr;
+	const char* replayPath = nullptr;
+	bool replayFast = false;
+	// Draw effects over the whole rig by LED position instead of the segment layout
+	bool spatialMode = false;
+	// Print every metric on the status line, not only the summary and those on the LEDs
+	bool verbose = false;
+	SourceOptions sourceOptions;
+	// Layout ranges to override, as metric=min,max
+	vector<const char*> ranges;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--subtract-self") == 0) {
+			sourceOptions.subtractSelf = true;
+		}
+		else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+			recordPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+			replayPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--fast") == 0) {
+			replayFast = true;
+		}
+		else if (strcmp(argv[i], "--net-include") == 0 && i + 1 < argc) {
+			sourceOptions.netInclude = split_list(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--net-exclude") == 0 && i + 1 < argc) {
+			sourceOptions.netExclude = split_list(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--net-virtual-totals") == 0) {
+			sourceOptions.netVirtualTotals = true;
+		}
+		else if (strcmp(argv[i], "--top") == 0 && i + 1 < argc) {
+			sourceOptions.topProcesses = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--cgroup") == 0 && i + 1 < argc) {
+			sourceOptions.cgroup = argv[++i];
+		}
+		else if (strcmp(argv[i], "--io-uring") == 0) {
+			sourceOptions.ioUring = true;
+		}
+		else if (strcmp(argv[i], "--numa-modules") == 0 && i + 1 < argc) {
+			for (const auto &node : split_list(argv[++i])) {
+				sourceOptions.numaModules.push_back(atoi(node.c_str()));
+			}
+		}
+		else if (strcmp(argv[i], "--period") == 0 && i + 1 < argc) {
+			// metric=min,max[,threshold], periods in milliseconds
+			const char* period = argv[++i];
+			const char* equals = strchr(period, '=');
+			vector<string> values = split_list(equals ? equals + 1 : "");
+			if (values.size() < 2) {
+				cout << "Ignoring period " << period << ", expected metric=min,max[,threshold]" << endl;
+				continue;
+			}
+			sourceOptions.periods.push_back({ string(period, equals), chrono::milliseconds(atoi(values[0].c_str())),
+			                                  chrono::milliseconds(atoi(values[1].c_str())),
+			                                  values.size() > 2 ? strtof(values[2].c_str(), nullptr) : 5.0f });
+		}
+		else if (strcmp(argv[i], "--range") == 0 && i + 1 < argc) {
+			ranges.push_back(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--spatial") == 0) {
+			spatialMode = true;
+		}
+		else if (strcmp(argv[i], "--verbose") == 0) {
+			verbose = true;
+		}
+		else {
+			cout << "Usage: " << argv[0] << " [--subtract-self] [--record file] [--replay file [--fast]]"
+			     << " [--net-include names] [--net-exclude names] [--net-virtual-totals] [--cgroup path] [--top count] [--io-uring] [--numa-modules nodes] [--period metric=min,max[,threshold]]... [--range metric=min,max]... [--spatial] [--verbose]" << endl;
+			return 1;
+		}
+	}
+
+	TRACE_INIT("pc-activity-rgb-trace.json");
+	// Devices first, as the NUMA source publishes a metric for each memory module
 	RgbLighting* lighting = new RgbLighting();
-	auto deviceMap = lighting->get_device_mapping();
+	const DeviceRegistry &devices = lighting->get_device_registry();
+	sourceOptions.memoryModules = static_cast<int>(devices.byType[CDT_MemoryModule].size());
+
+	MetricRegistry registry;
+	if (replayPath) {
+		registry.add(new ActivityReplay(replayPath, !replayFast));
+	}
+	else {
+		register_default_sources(registry, sourceOptions);
+	}
+	ActivityRecorder* recorder = recordPath ? new ActivityRecorder(recordPath, registry) : nullptr;
 
 	// Set theme
 	//green_theme();
 	cyberpunk_theme();
+	Layout layout(lighting, devices, registry, theme);
+	for (const char* range : ranges) {
+		const char* equals = strchr(range, '=');
+		vector<string> bounds = split_list(equals ? equals + 1 : "");
+		if (bounds.size() != 2) {
+			cout << "Ignoring range " << range << ", expected metric=min,max" << endl;
+			continue;
+		}
+		layout.set_range(registry, string(range, equals), strtof(bounds[0].c_str(), nullptr),
+		                 strtof(bounds[1].c_str(), nullptr));
+	}
+
+	vector<MetricId> statusMetrics = status_metrics(registry, layout, verbose);
+	SpatialLayout* spatial = spatialMode ? new SpatialLayout(lighting, devices, registry, theme) : nullptr;
+
+	// Reused every frame, so the loop does not allocate once it has warmed up
+	LedMap ledMap;
+
+	bool running = true;
+	while (running) {
+		running = registry.wait_and_sample(spatial ? spatial->next_frame() : chrono::steady_clock::time_point::max());
+		auto now = chrono::steady_clock::now();
+		if (lighting->check_devices(now)) {
+			layout.update_devices(registry, devices, lighting->changed_devices());
+			statusMetrics = status_metrics(registry, layout, verbose);
+			if (spatial) {
+				spatial->update_devices(devices);
+			}
+		}
+		// Frames between samples only move the spatial effects on
+		if (spatial && !registry.sampled()) {
+			spatial->render(registry, now, ledMap);
+			lighting->set_colors(ledMap);
+			continue;
+		}
+		if (recorder) {
+			recorder->record(registry);
+		}
 
-	while(true) {
-		time_t curTime = time(NULL);
-		tm *time = localtime(&curTime);
-		auto memPct = activity->get_memory_usage();
-		auto cpuPct = activity->get_cpu_load();
-		auto gpuPct = activity->get_gpu_load();
-		cout << "Time: " << setw(2) << setfill('0') << time->tm_hour 
-		                 << ":" << setw(2) << setfill('0') << time->tm_min
-						 << ":" << setw(2) << setfill('0') << time->tm_sec;
-		cout << ", Memory: " << memPct << "%";
-		cout << ", CPU:" << cpuPct << "%";
-		cout << ", GPU:" << gpuPct << "%" << endl;
-
-	 	LedMap ledMap = lighting->get_led_arrays();
-		lighting->load_device_colors_activity("cpu", 0, deviceMap["CommanderPro"], cpuPct, ledMap, cpu_base, cpu_active);
-		lighting->load_device_colors_activity("gpu", 0, deviceMap["CommanderPro"], gpuPct, ledMap, gpu_base, gpu_active);
-
-		// Assumes 4 sticks of RAM, exercise left to generalize
-	 	lighting->load_device_colors_activity("ram", 0, deviceMap["MemoryModule"],      min(memPct*4, 100), ledMap, ram_base, ram_active);
-	 	lighting->load_device_colors_activity("ram", 0, deviceMap["MemoryModule"] + 1,  min((memPct-25)*4, 100), ledMap, ram_base, ram_active);
-	 	lighting->load_device_colors_activity("ram", 0, deviceMap["MemoryModule"] + 2,  min((memPct-50)*4, 100), ledMap, ram_base, ram_active);
-	 	lighting->load_device_colors_activity("ram", 0, deviceMap["MemoryModule"] + 3,  min((memPct-75)*4, 100), ledMap, ram_base, ram_active);
-
-		// Show time on fans, hour (top), first digit of minute, second digit (bottom)
-		lighting->load_device_colors_binary("fan", 0, deviceMap["CommanderPro"], time->tm_hour % 12, ledMap, fans_one, fans_zero);
-		lighting->load_device_colors_binary("fan", 1, deviceMap["CommanderPro"], time->tm_min / 10, ledMap, fans_one, fans_zero);
-		lighting->load_device_colors_binary("fan", 2, deviceMap["CommanderPro"], time->tm_min % 10, ledMap, fans_one, fans_zero);
-		
-		lighting->load_device_colors_static("reservoir", 0, deviceMap["CommanderPro"], ledMap, pump);
+		registry.print_status_line(cout, statusMetrics, time(NULL));
+		cout << endl;
 
+		if (spatial) {
+			spatial->render(registry, now, ledMap);
+		}
+		else {
+			layout.render(registry, ledMap);
+		}
 	 	lighting->set_colors(ledMap);
-		std::this_thread::sleep_for(std::chrono::seconds(5));
 	}
 
 	// For debugging